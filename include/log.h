@@ -18,12 +18,30 @@ typedef void (*log_LockFn)(void *udata, int lock);
 
 enum { LOG_TRACE, LOG_DEBUG, LOG_INFO, LOG_WARN, LOG_ERROR, LOG_FATAL };
 
-#define log_trace(...) log_log(LOG_TRACE, __FILE__, __LINE__, __VA_ARGS__)
-#define log_debug(...) log_log(LOG_DEBUG, __FILE__, __LINE__, __VA_ARGS__)
-#define log_info(...)  log_log(LOG_INFO,  __FILE__, __LINE__, __VA_ARGS__)
-#define log_warn(...)  log_log(LOG_WARN,  __FILE__, __LINE__, __VA_ARGS__)
-#define log_error(...) log_log(LOG_ERROR, __FILE__, __LINE__, __VA_ARGS__)
-#define log_fatal(...) log_log(LOG_FATAL, __FILE__, __LINE__, __VA_ARGS__)
+#define LOG_MAX_ARGS 16
+
+/* One per call site of the log_* macros, for the binary log */
+typedef struct {
+  int level;
+  const char *file;
+  int line;
+  unsigned id;          /* assigned on the first message */
+  unsigned defined;     /* binary log the site was described in */
+  int argc;             /* -1 = format not parsed yet, -2 = written as text */
+  char kinds[LOG_MAX_ARGS];
+} log_Site;
+
+#define log_site(level, ...) do { \
+    static log_Site log_site_ = { level, __FILE__, __LINE__, 0, 0, -1, {0} }; \
+    log_log_site(&log_site_, __VA_ARGS__); \
+  } while (0)
+
+#define log_trace(...) log_site(LOG_TRACE, __VA_ARGS__)
+#define log_debug(...) log_site(LOG_DEBUG, __VA_ARGS__)
+#define log_info(...)  log_site(LOG_INFO,  __VA_ARGS__)
+#define log_warn(...)  log_site(LOG_WARN,  __VA_ARGS__)
+#define log_error(...) log_site(LOG_ERROR, __VA_ARGS__)
+#define log_fatal(...) log_site(LOG_FATAL, __VA_ARGS__)
 
 void log_set_udata(void *udata);
 void log_set_lock(log_LockFn fn);
@@ -32,7 +50,15 @@ void log_set_level(int level);
 void log_set_quiet(int enable);
 int log_get_level();
 const char* log_get_level_name();
+unsigned long log_get_dropped(); /* messages that could not be written */
+
+/* Binary log: only the arguments of a message are written, the format once per call site.
+ * Warnings and errors still go to stderr. NULL closes the binary log. */
+int log_set_binary(const char *path);
+/* Writes the messages of a binary log as text */
+int log_decode(const char *path, FILE *out);
 
-void log_log(int level, const char *file, int line, const char *fmt, ...);
+void log_log(int level, const char *file, int line, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+void log_log_site(log_Site *site, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
 
 #endif
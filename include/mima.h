@@ -20,12 +20,38 @@ typedef uint8_t 	mima_bool;
 #define mima_integer_input  0xc000002
 #define mima_char_output 	0xc000003
 #define mima_integer_output	0xc000004
+#define mima_core_id		0xc000005
+#define mima_core_count		0xc000006
+
+// DMA controller (opt-in): set source, destination and length, then write anything to start
+#define mima_dma_source			0xc000010
+#define mima_dma_destination	0xc000011
+#define mima_dma_length			0xc000012
+#define mima_dma_start			0xc000013
+
+// Interrupt controller and timer (opt-in), see mima_interrupts.h
+#define mima_irq_vector			0xc000020
+#define mima_irq_enable			0xc000021
+#define mima_irq_status			0xc000022
+#define mima_timer_period		0xc000023
+#define mima_irq_saved_iar		0xc000024
+#define mima_irq_saved_acc		0xc000025
+#define mima_irq_return			0xc000026
+#define mima_input_data			0xc000027
+
+#define mima_irq_timer	1
+#define mima_irq_input	2
 
 typedef enum _mima_instruction_type
 {
-    ADD = 0, AND, OR, XOR, LDV, STV, LDC, JMP, JMN, EQL, HLT = 0xF0, NOT, RAR, RRN
+    ADD = 0, AND, OR, XOR, LDV, STV, LDC, JMP, JMN, EQL, HLT = 0xF0, NOT, RAR, RRN,
+    // extended ISA (--extended-isa)
+    MUL = 0xF4, SUB, SHL, SHR, LDIV, STIV, CALL, RET
 } mima_instruction_type;
 
+// opt-in, both the assembler and the engines reject MUL - RET without it
+extern mima_bool mima_extended_isa;
+
 typedef struct _mima_instruction
 {
     mima_instruction_type 	op_code;
@@ -38,6 +64,7 @@ typedef struct _mima_control_unit
     mima_register 	IR;
     mima_register 	IAR;
     mima_register 	IP;
+    mima_register 	SP;		// CALL / RET stack, grows down from mima_words
     mima_flag 		TRA;
     mima_flag 		RUN;
 } mima_control_unit;
@@ -47,6 +74,12 @@ typedef struct _mima_memory_unit
     mima_register 	SIR;
     mima_register 	SAR;
     mima_word 		*memory;
+    uint64_t		*dirty_pages;		// one bit per page ever written
+    mima_word		**baseline_pages;	// copy-on-write page copies since the last baseline
+    uint64_t		*snapshot_pending;	// pages a running checkpoint has not read yet, NULL = none
+    mima_word		**snapshot_pages;	// their old content, if they were written in the meantime
+    uint32_t		dirty_pages_count;
+    mima_bool		shared;				// cores on other threads use the memory, stores are sequentially consistent
 } mima_memory_unit;
 
 typedef struct _mima_processing_unit
@@ -61,12 +94,114 @@ typedef struct _mima_processing_unit
     //		ALU;
 } mima_processing_unit;
 
+// timing model slots: standard op codes 0x0 - 0xF, extended op codes 0xF0 - 0xFF
+#define mima_op_slots 32
+
+static inline uint32_t mima_op_slot(mima_instruction_type op_code)
+{
+    return op_code < 0x10 ? op_code : 0x10 + (op_code & 0xF);
+}
+
+typedef struct _mima_timing
+{
+    uint32_t		cycles[mima_op_slots];
+    uint32_t		io_read_latency;
+    uint32_t		io_write_latency;
+    uint32_t		cache_miss_latency;
+} mima_timing;
+
+typedef struct _mima_counters
+{
+    uint64_t		instructions;
+    uint64_t		micro_cycles;		// micro steps the engines actually walked
+    uint64_t		cycles;				// cycles of the timing model
+    uint64_t		io_reads;
+    uint64_t		io_writes;
+    uint64_t		output_bytes;		// printed by the output devices
+    uint64_t		op_instructions[mima_op_slots];
+} mima_counters;
+
+typedef struct _mima_dma_controller
+{
+    mima_bool		enabled;
+    uint32_t		cycles_per_word;
+    mima_register	source;
+    mima_register	destination;
+    mima_register	length;
+    uint64_t		transfers;
+    uint64_t		words;
+} mima_dma_controller;
+
+struct _mima_input;
+
+typedef struct _mima_interrupt_controller
+{
+    mima_bool			enabled;
+    mima_bool			active;			// in the handler, further interrupts wait for IRET
+    mima_register		vector;
+    uint32_t			mask;
+    uint32_t			pending;		// the input thread sets its bit, too
+    uint32_t			period;			// of the timer in instructions, 0 = off
+    uint64_t			next_tick;
+    mima_register		saved_IAR;
+    mima_register		saved_ACC;
+    uint64_t			due;			// instruction count of the next check, the input thread sets it to 0
+    uint64_t			delivered;
+    struct _mima_input	*input;			// started on first use
+} mima_interrupt_controller;
+
+// why the Mima stopped the last time
+typedef enum _mima_stop_reason
+{
+    MIMA_STOP_NONE = 0,
+    MIMA_STOP_HALT,
+    MIMA_STOP_ERROR,			// the program did not assemble or accessed memory out of range
+    MIMA_STOP_INPUT,			// the recorded input ran out
+    // watchdog limits
+    MIMA_STOP_INSTRUCTIONS,
+    MIMA_STOP_TIME,
+    MIMA_STOP_PAGES,
+    MIMA_STOP_OUTPUT
+} mima_stop_reason;
+
+// watchdog limits, 0 = unlimited (see mima_watchdog.h)
+typedef struct _mima_limits
+{
+    uint64_t		instructions;
+    uint64_t		seconds;			// wall time since the limits were set
+    uint32_t		pages;				// pages written, the program included
+    uint64_t		output_bytes;
+    uint64_t		due;				// instruction count of the next check
+    uint64_t		start;				// monotonic milliseconds
+} mima_limits;
+
+struct _mima_pipeline;
+struct _mima_cache;
+struct _mima_predictor;
+struct _mima_io_log;
+struct _mima_checkpoint;
+struct _mima_telemetry;
+
 typedef struct _mima_t
 {
     mima_control_unit 		control_unit;
     mima_memory_unit 		memory_unit;
     mima_processing_unit 	processing_unit;
     mima_instruction 		current_instruction;
+    mima_counters			counters;
+    mima_timing				timing;
+    mima_dma_controller		dma;
+    mima_interrupt_controller	interrupts;
+    mima_limits				limits;
+    mima_stop_reason		stop_reason;
+    uint32_t				core;				// this core and the number of cores sharing the memory
+    uint32_t				cores;
+    struct _mima_pipeline	*pipeline;			// optional models, NULL = off
+    struct _mima_cache		*cache;
+    struct _mima_predictor	*predictor;
+    struct _mima_io_log		*io_log;			// record / replay of terminal input
+    struct _mima_checkpoint	*checkpoint;		// periodic snapshots, NULL = off
+    struct _mima_telemetry	*telemetry;			// counters for dashboards, NULL = off
 } mima_t;
 
 mima_t mima_init();
@@ -80,10 +215,17 @@ void mima_run_instruction_steps(mima_t *mima, char* steps);
 
 void mima_micro_instruction_step(mima_t *mima);
 
+// fast engine: whole instructions at once, same register effects as 12 micro steps
+void mima_execute_instruction(mima_t *mima);
+uint64_t mima_run_fast(mima_t *mima, uint64_t max_instructions);
+
+mima_bool mima_io_read(mima_t *mima, mima_register address, mima_word *value);
+mima_bool mima_io_write(mima_t *mima, mima_register address, mima_word value);
+
 mima_instruction mima_instruction_decode(mima_t *mima);
 mima_bool mima_sar_external(mima_t *mima);
 
-// ADD, AND, OR, XOR, EQL
+// ADD, AND, OR, XOR, EQL, MUL, SUB
 void mima_instruction_common(mima_t *mima);
 void mima_instruction_LDV(mima_t *mima);
 void mima_instruction_STV(mima_t *mima);
@@ -94,10 +236,16 @@ void mima_instruction_JMN(mima_t *mima);
 void mima_instruction_NOT(mima_t *mima);
 void mima_instruction_RAR(mima_t *mima);
 void mima_instruction_RRN(mima_t *mima);
+void mima_instruction_SHIFT(mima_t *mima);
+void mima_instruction_LDIV(mima_t *mima);
+void mima_instruction_STIV(mima_t *mima);
+void mima_instruction_CALL(mima_t *mima);
+void mima_instruction_RET(mima_t *mima);
 
 const char *mima_get_instruction_name(mima_instruction_type instruction);
 
 void mima_print_state(mima_t *mima);
+void mima_print_counters(mima_t *mima);
 void mima_print_memory_at(mima_t *mima, mima_register address, uint32_t count);
 void mima_print_memory_unit_state(mima_t *mima);
 void mima_print_control_unit_state(mima_t *mima);
@@ -0,0 +1,24 @@
+#ifndef mima_analysis_h
+#define mima_analysis_h
+
+#include "mima.h"
+
+// Control flow analysis of mima_assembled_image, starting at address 0.
+// Words below instructions_count are code, all other assembled words are data.
+//
+// Errors (the program cannot run sensibly):
+//   - jumps or falls through into uninitialized memory or the I/O space
+//   - loops that can neither leave nor do I/O
+//   - no HLT is reachable
+// Warnings:
+//   - unreachable code
+//   - jumps into data, stores into code (self modifying code makes the graph approximate)
+typedef struct _mima_analysis_result
+{
+    uint32_t	errors;
+    uint32_t	warnings;
+} mima_analysis_result;
+
+mima_analysis_result mima_analyze_image();
+
+#endif // mima_analysis_h
@@ -0,0 +1,58 @@
+#ifndef mima_cache_h
+#define mima_cache_h
+
+#include "mima.h"
+
+// Set associative cache model in front of general purpose memory, LRU replacement.
+// Sizes are given in Mima words and must be powers of two.
+// Write back allocates lines on write misses, write through does not.
+typedef struct _mima_cache_line
+{
+    uint32_t		line;			// address >> line_words_log2
+    uint64_t		last_use;
+    mima_bool		valid;
+    mima_bool		dirty;
+} mima_cache_line;
+
+typedef struct _mima_cache_miss
+{
+    mima_register	address;
+    uint64_t		count;
+} mima_cache_miss;
+
+typedef struct _mima_cache
+{
+    uint32_t		size_words;
+    uint32_t		ways;
+    uint32_t		line_words;
+    uint32_t		line_words_log2;
+    uint32_t		sets;
+    mima_bool		write_back;
+
+    mima_cache_line	*lines;			// sets * ways
+    uint64_t		clock;
+
+    uint64_t		reads;
+    uint64_t		writes;
+    uint64_t		read_misses;
+    uint64_t		write_misses;
+    uint64_t		evictions;
+    uint64_t		write_backs;
+
+    // misses per word address, open addressing (address + 1, 0 = empty)
+    mima_cache_miss	*misses;
+    uint32_t		misses_capacity;
+    uint32_t		misses_count;
+} mima_cache;
+
+// "size,ways,line[,wb|wt]" e.g. "1024,2,8,wb"
+mima_cache *mima_cache_create(const char *config);
+void mima_cache_delete(mima_cache *cache);
+
+// Returns mima_true on a hit.
+mima_bool mima_cache_access(mima_cache *cache, mima_register address, mima_bool write);
+
+// Counters and the count addresses with the most misses.
+void mima_cache_print_stats(mima_cache *cache, uint32_t count);
+
+#endif // mima_cache_h
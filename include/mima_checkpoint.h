@@ -0,0 +1,72 @@
+#ifndef mima_checkpoint_h
+#define mima_checkpoint_h
+
+#include <pthread.h>
+#include <time.h>
+#include "mima.h"
+
+// Periodic checkpoints of a running Mima (--checkpoint file[,every[s][,keep]]).
+// At an instruction boundary the engine copies its registers and marks the dirty pages as a copy-on-write snapshot,
+// a background thread writes them into file.0 ... file.(keep - 1) in turns while the engine keeps running.
+// Pages the engine writes before the thread got to them are copied first.
+// If the thread is still writing when the next checkpoint is due, the engine tries again shortly after,
+// once it is a whole interval behind it waits for the thread.
+//
+// File: "MIMACKP1", uint64 sequence, uint32 sizeof(mima_checkpoint_state), uint32 pages,
+// the state, then per page its number (uint32) and 1024 words (host byte order).
+// Every file is written under a temporary name and renamed when it is complete.
+
+#define MIMA_CHECKPOINT_MAX_KEEP 16
+#define MIMA_CHECKPOINT_POLL 65536          // instructions between two looks at the clock
+
+typedef struct _mima_checkpoint_state
+{
+    mima_control_unit		control_unit;
+    mima_register			SIR;
+    mima_register			SAR;
+    mima_processing_unit	processing_unit;
+    mima_instruction		current_instruction;
+    mima_counters			counters;
+    mima_dma_controller		dma;
+    mima_interrupt_controller	interrupts;		// without the input thread
+    uint64_t				io_log_offset;		// position in the I/O recording, 0 without one
+    uint64_t				io_log_instruction;
+    uint64_t				io_log_records;
+} mima_checkpoint_state;
+
+typedef struct _mima_checkpoint
+{
+    char					file_name[4096];
+    uint64_t				every_instructions;	// 0 -> every_seconds
+    uint32_t				every_seconds;
+    uint32_t				keep;
+    uint64_t				due;				// instruction count of the next mima_checkpoint_tick()
+    time_t					last;
+    uint64_t				sequence;			// of the last snapshot taken
+
+    // shared with the writer thread
+    pthread_t				thread;
+    pthread_mutex_t			mutex;
+    pthread_cond_t			condition;
+    mima_bool				busy;				// a snapshot is being written
+    mima_bool				quit;
+    mima_checkpoint_state	state;
+    uint64_t				*pages;
+    uint32_t				pages_count;
+    mima_memory_unit		*memory_unit;
+    uint64_t				written;
+} mima_checkpoint;
+
+mima_checkpoint *mima_checkpoint_create(const char *config, mima_t *mima);
+
+// Waits for a checkpoint that is being written.
+void mima_checkpoint_delete(mima_checkpoint *checkpoint, mima_t *mima);
+
+// Called when an instruction retires and counters.instructions reached due.
+void mima_checkpoint_tick(mima_checkpoint *checkpoint, mima_t *mima);
+
+// Loads the newest complete checkpoint of file.0 ... into a freshly compiled Mima.
+// A replayed recording continues at the read the checkpoint was taken at, a new recording cannot continue one.
+mima_bool mima_checkpoint_resume(mima_t *mima, const char *file_name);
+
+#endif // mima_checkpoint_h
@@ -3,7 +3,33 @@
 
 #define INITIAL_LABEL_CAPACITY 8
 
+// Sources larger than this are split into line aligned chunks and assembled on multiple threads.
+#define MIMA_PARALLEL_COMPILE_THRESHOLD (4 * 1024 * 1024)
+#define MIMA_PARALLEL_COMPILE_MIN_CHUNK (1024 * 1024)
+#define MIMA_PARALLEL_COMPILE_MAX_THREADS 64
+
+typedef struct _mima_image_entry
+{
+    uint32_t address;
+    mima_word word;
+    uint32_t file;      // see mima_source_location()
+    uint32_t line;
+} mima_image_entry;
+
+// every word written by the assembler, sorted by address
+typedef struct _mima_image
+{
+    mima_image_entry *entries;
+    size_t count;
+    size_t instructions_count;
+} mima_image;
+
+extern mima_image mima_assembled_image;
+
 mima_bool mima_compile_file(mima_t *mima, const char *file_name);
+mima_bool mima_reassemble_file(mima_t *mima, const char *file_name);
+mima_bool mima_compile_buffer(mima_t *mima, const char *source, size_t size, uint32_t threads);
+void mima_image_free(mima_image *image);
 mima_bool mima_assemble_instruction(mima_register *instruction, uint32_t op_code, uint32_t value, size_t line);
 
 typedef struct _mima_label
@@ -14,9 +40,18 @@ typedef struct _mima_label
 
 extern uint32_t labels_count;
 extern uint32_t labels_capacity;
-mima_label *mima_labels;
+extern mima_label *mima_labels;
+extern uint32_t mima_labels_generation;     // changes whenever mima_labels change
+
+// Source file and line of a line of the assembled text. Expansions of the preprocessor mark where their
+// lines came from, sources without directives are assembled as they are.
+void mima_source_position(size_t assembled_line, uint32_t *file, uint32_t *line);
+
+// "lib/print.asm:12" for diagnostics, "Line 012" if the source had no directives.
+const char *mima_source_location(uint32_t file, uint32_t line);
+const char *mima_assembled_location(size_t assembled_line);
 
 void mima_push_label(const char *label_name, uint32_t address, size_t line);
 uint32_t mima_address_for_label(const char *label_name, size_t line);
 
-#endif // mima_compiler_h
\ No newline at end of file
+#endif // mima_compiler_h
@@ -0,0 +1,25 @@
+#ifndef mima_debug_server_h
+#define mima_debug_server_h
+
+#include "mima.h"
+
+// Debug stub speaking a subset of the GDB remote serial protocol.
+// Packets are framed as "$data#checksum" and acknowledged with '+', 0x03 interrupts a running machine.
+//
+// ?                    stop reason: S05 (stopped), S02 (interrupted) or W00 (halted)
+// g                    all registers: ACC IAR IR SAR SIR X Y Z MICRO_CYCLE RUN SP, 8 hex digits each
+// p n / P n=value      read / write register n (same order as above)
+// m addr,#             read # words at address (8 hex digits per word, most significant first)
+// M addr,#:words       write # words at address
+// s                    execute one instruction
+// c                    continue until HLT, breakpoint or interrupt
+// Z0,addr,0 / z0,...   insert / remove a breakpoint on an instruction address
+// D                    detach this client
+// k                    stop the server
+//
+// Several clients can be connected at once, all of them share the machine. While one client continues it,
+// s and c from the others are answered with E05 (busy).
+// The endpoint is either a port number (TCP on 127.0.0.1) or a path (Unix domain socket).
+mima_bool mima_debug_server_run(mima_t *mima, const char *endpoint);
+
+#endif // mima_debug_server_h
@@ -0,0 +1,20 @@
+#ifndef mima_devices_h
+#define mima_devices_h
+
+#include "mima.h"
+
+// Maps a host file (read-only, host byte order) into guest memory at address.
+// The address must be page aligned, at most max_words words are mapped (0 = the whole file). Whole host pages
+// are mapped, the rest of the window is copied, words behind it keep their content.
+// Writes by the program stay private to the guest, the file is never modified.
+mima_bool mima_device_map_file(mima_t *mima, const char *file_name, mima_register address, uint32_t max_words);
+
+// DMA controller at mima_dma_source - mima_dma_start, only answers if mima->dma.enabled is set.
+// A write to mima_dma_start copies length words from source to destination (memmove semantics)
+// and charges cycles_per_word micro cycles per word. Reading mima_dma_start yields 0 (idle), the
+// transfer completes before the writing STV retires.
+void mima_device_dma_enable(mima_t *mima, uint32_t cycles_per_word);
+mima_bool mima_device_dma_read(mima_t *mima, mima_register address, mima_word *value);
+mima_bool mima_device_dma_write(mima_t *mima, mima_register address, mima_word value);
+
+#endif // mima_devices_h
@@ -0,0 +1,20 @@
+#ifndef mima_disassembler_h
+#define mima_disassembler_h
+
+#include <stdio.h>
+#include "mima.h"
+
+// Disassembled lines are cached per address. An entry is valid as long as the word at its
+// address and the label generation of the assembler did not change, so writes need no hook.
+#define MIMA_DISASSEMBLER_CACHE_LOG2 12
+
+// "JMN LOOP", "LDV 0x00000ff0", ... The string lives in the cache until address is decoded again.
+const char *mima_disassemble(mima_register address, mima_word word);
+
+// First label declared at address or NULL.
+const char *mima_disassembler_label_at(mima_register address);
+
+// Like mima_memory_print, with label lines and the disassembly next to every word.
+void mima_disassembler_print(mima_memory_unit *memory_unit, FILE *out, mima_register address, uint32_t count);
+
+#endif // mima_disassembler_h
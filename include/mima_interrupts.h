@@ -0,0 +1,52 @@
+#ifndef mima_interrupts_h
+#define mima_interrupts_h
+
+#include <pthread.h>
+#include "mima.h"
+
+// Interrupt controller with a timer and asynchronous terminal input (--interrupts).
+//   mima_irq_vector     handler address
+//   mima_irq_enable     mask of the interrupts to deliver (mima_irq_timer, mima_irq_input)
+//   mima_irq_status     read: pending interrupts, write: acknowledge the given bits
+//   mima_timer_period   raise mima_irq_timer every # instructions, 0 = off
+//   mima_irq_saved_iar  IAR and ACC of the interrupted program (writable)
+//   mima_irq_saved_acc
+//   mima_irq_return     write anything: continue at the saved IAR with the saved ACC (IRET)
+//   mima_input_data     read: next input byte or -1, never waits
+// An interrupt is delivered when an instruction retires, a handler is never interrupted itself.
+// Once the program enables mima_irq_input or reads mima_input_data, a host thread owns stdin and fills a ring
+// buffer, the terminal devices and the shell then read from that buffer as well.
+
+#define MIMA_INPUT_RING 4096
+
+typedef struct _mima_input
+{
+    pthread_t					thread;
+    pthread_mutex_t				mutex;
+    pthread_cond_t				condition;
+    mima_bool					quit;
+    mima_bool					end;			// stdin is closed
+    uint8_t						ring[MIMA_INPUT_RING];
+    uint32_t					head;			// next byte to read
+    uint32_t					count;
+    uint64_t					dropped;		// the program did not keep up
+    mima_interrupt_controller	*controller;
+} mima_input;
+
+void mima_interrupts_enable(mima_t *mima);
+
+// Stops the input thread.
+void mima_interrupts_delete(mima_t *mima);
+
+// Called when an instruction retires and counters.instructions reached interrupts.due.
+void mima_interrupts_check(mima_t *mima);
+
+mima_bool mima_interrupts_read(mima_t *mima, mima_register address, mima_word *value);
+mima_bool mima_interrupts_write(mima_t *mima, mima_register address, mima_word value);
+
+// Blocking reads of stdin for the terminal devices and the shell, they go through the ring buffer once the
+// input thread runs. getchar and fgets semantics.
+int mima_input_getchar(mima_t *mima);
+char *mima_input_gets(mima_t *mima, char *buffer, int size);
+
+#endif // mima_interrupts_h
@@ -0,0 +1,33 @@
+#ifndef mima_iolog_h
+#define mima_iolog_h
+
+#include <stdio.h>
+#include "mima.h"
+
+// Record / replay of the terminal inputs (mima_char_input, mima_integer_input).
+// File: "MIMAIO1\n", then one record per read:
+//   varint  instructions retired since the previous read
+//   uint8   input address - 0xc000000
+//   varint  value
+typedef struct _mima_io_log
+{
+    FILE			*file;
+    mima_bool		replay;
+    uint64_t		instruction;	// instruction count of the previous record
+    uint64_t		records;
+} mima_io_log;
+
+mima_io_log *mima_io_log_open(const char *file_name, mima_bool replay);
+void mima_io_log_close(mima_io_log *io_log);
+
+void mima_io_log_record(mima_io_log *io_log, uint64_t instruction, mima_register address, mima_word value);
+
+// Returns mima_false when the recording is exhausted. A read at another address or
+// instruction than recorded is reported, the recorded value is used anyway.
+mima_bool mima_io_log_replay(mima_io_log *io_log, uint64_t instruction, mima_register address, mima_word *value);
+
+// Position in the file for checkpoints, replay continues there after mima_io_log_seek().
+uint64_t mima_io_log_tell(mima_io_log *io_log);
+mima_bool mima_io_log_seek(mima_io_log *io_log, uint64_t offset, uint64_t instruction, uint64_t records);
+
+#endif // mima_iolog_h
@@ -0,0 +1,115 @@
+#ifndef mima_memory_h
+#define mima_memory_h
+
+#include <stdio.h>
+#include "mima.h"
+
+// Memory is tracked in pages of 1024 words (4 KiB).
+#define mima_page_words_log2    10
+#define mima_page_words         (1 << mima_page_words_log2)
+#define mima_pages              ((mima_words + mima_page_words - 1) / mima_page_words)
+#define mima_page_of(address)   ((address) >> mima_page_words_log2)
+
+mima_bool mima_memory_init(mima_memory_unit *memory_unit);
+void mima_memory_delete(mima_memory_unit *memory_unit);
+
+void mima_memory_save_baseline_page(mima_memory_unit *memory_unit, uint32_t page);
+void mima_memory_reset_baseline(mima_memory_unit *memory_unit);
+void mima_memory_mark_dirty_range(mima_memory_unit *memory_unit, mima_register address, uint32_t count);
+
+static inline mima_bool mima_memory_page_dirty(const mima_memory_unit *memory_unit, uint32_t page)
+{
+    return (memory_unit->dirty_pages[page >> 6] >> (page & 63)) & 1;
+}
+
+static inline void mima_memory_mark_dirty(mima_memory_unit *memory_unit, uint32_t page)
+{
+    uint64_t mask = 1ull << (page & 63);
+
+    // the bitmap word is only written once per page, the core that sets the bit counts the page
+    if (!(__atomic_load_n(&memory_unit->dirty_pages[page >> 6], __ATOMIC_RELAXED) & mask) &&
+        !(__atomic_fetch_or(&memory_unit->dirty_pages[page >> 6], mask, __ATOMIC_RELAXED) & mask))
+    {
+        memory_unit->dirty_pages_count++;
+    }
+}
+
+// Copy-on-write snapshot of the dirty pages for checkpoints, taken by the engine thread and read by another one.
+// Returns the number of pages, their bits are set in pages.
+uint32_t mima_memory_snapshot_begin(mima_memory_unit *memory_unit, uint64_t *pages);
+void mima_memory_snapshot_save_page(mima_memory_unit *memory_unit, uint32_t page);
+void mima_memory_snapshot_read_page(mima_memory_unit *memory_unit, uint32_t page, mima_word *words);
+void mima_memory_snapshot_end(mima_memory_unit *memory_unit);
+
+// Bookkeeping before a page changes, the copies have to be taken first.
+static inline void mima_memory_prepare_page(mima_memory_unit *memory_unit, uint32_t page)
+{
+    mima_memory_mark_dirty(memory_unit, page);
+
+    // copy-on-write: keep the content of the page from the last baseline for "memdiff"
+    if (!__atomic_load_n(&memory_unit->baseline_pages[page], __ATOMIC_ACQUIRE))
+    {
+        mima_memory_save_baseline_page(memory_unit, page);
+    }
+
+    // ... and for a checkpoint that did not get to the page yet
+    if (memory_unit->snapshot_pending && (__atomic_load_n(&memory_unit->snapshot_pending[page >> 6], __ATOMIC_ACQUIRE) >> (page & 63)) & 1)
+    {
+        mima_memory_snapshot_save_page(memory_unit, page);
+    }
+}
+
+// Every write into general purpose memory (STV, assembler, shell) goes through here.
+// Returns false for an address behind the memory, nothing is written or tracked then.
+static inline mima_bool mima_memory_write(mima_memory_unit *memory_unit, mima_register address, mima_word value)
+{
+    if (address >= mima_words)
+    {
+        return mima_false;
+    }
+
+    mima_memory_prepare_page(memory_unit, mima_page_of(address));
+
+    if (memory_unit->shared)
+    {
+        __atomic_store_n(&memory_unit->memory[address], value, __ATOMIC_SEQ_CST);
+    }
+    else
+    {
+        memory_unit->memory[address] = value;
+    }
+
+    return mima_true;
+}
+
+// Every read of general purpose memory by the engines, a word is never torn by a store of another core.
+static inline mima_word mima_memory_read(const mima_memory_unit *memory_unit, mima_register address)
+{
+    return __atomic_load_n(&memory_unit->memory[address], __ATOMIC_SEQ_CST);
+}
+
+// Block copy inside general purpose memory (ranges may overlap), tracked like count single writes.
+void mima_memory_move(mima_memory_unit *memory_unit, mima_register destination, mima_register source, uint32_t count);
+
+// Block write into general purpose memory, tracked like count single writes.
+void mima_memory_write_block(mima_memory_unit *memory_unit, mima_register address, const mima_word *words, uint32_t count);
+
+#define mima_output_buffer_size (64 * 1024)
+
+// Dumps are formatted into a buffer and written in bulk instead of one printf per word.
+typedef struct _mima_output_buffer
+{
+    FILE *out;
+    size_t used;
+    char data[mima_output_buffer_size];
+} mima_output_buffer;
+
+void mima_output_flush(mima_output_buffer *buffer);
+void mima_output_string(mima_output_buffer *buffer, const char *string);
+void mima_output_hex(mima_output_buffer *buffer, uint32_t value);
+
+void mima_memory_dump_dirty(mima_memory_unit *memory_unit, FILE *out, mima_bool binary);
+void mima_memory_diff(mima_memory_unit *memory_unit, FILE *out, mima_bool binary);
+void mima_memory_print(mima_memory_unit *memory_unit, FILE *out, mima_register address, uint32_t count);
+
+#endif // mima_memory_h
@@ -0,0 +1,24 @@
+#ifndef mima_memscan_h
+#define mima_memscan_h
+
+#include "mima.h"
+
+typedef struct _mima_checksum
+{
+    uint64_t sum;   // sum of all words
+    uint32_t xor;   // xor of all words
+} mima_checksum;
+
+// Kernels over plain word arrays, using AVX2 or SSE2 when available.
+uint32_t mima_scan_find(const mima_word *words, uint32_t count, mima_word value);
+void mima_scan_fill(mima_word *words, uint32_t count, mima_word value);
+void mima_scan_checksum(const mima_word *words, uint32_t count, mima_checksum *checksum);
+const char *mima_scan_kernel_name();
+
+// Page aware versions for guest memory, pages that were never written are known to be zero and skipped.
+// Returns the number of matches, at most max_matches addresses are stored.
+uint32_t mima_memory_find(mima_memory_unit *memory_unit, mima_register address, uint32_t count, mima_word value, mima_register *matches, uint32_t max_matches);
+void mima_memory_fill(mima_memory_unit *memory_unit, mima_register address, uint32_t count, mima_word value);
+void mima_memory_checksum(mima_memory_unit *memory_unit, mima_register address, uint32_t count, mima_checksum *checksum);
+
+#endif // mima_memscan_h
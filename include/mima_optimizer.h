@@ -0,0 +1,22 @@
+#ifndef mima_optimizer_h
+#define mima_optimizer_h
+
+#include "mima.h"
+
+// Peephole optimizer, runs on the assembled code before it is emitted (--optimize):
+//   STV x; LDV x   ->  STV x
+//   LDC 0; ADD y   ->  LDV y
+//   NOT; NOT       ->  (nothing)
+// A pattern is left alone if a label points into its middle or x / y is in the I/O space.
+// Removed instructions shift the code behind them, so operands and .word values that came from labels and
+// the labels themselves are relocated. Code with numeric references into itself or stores into itself is not touched.
+
+extern mima_bool mima_optimize;
+
+// label_operands marks the instructions whose operand was a label.
+// All three arrays are compacted in place, returns the new number of instructions.
+// If that is less than count, relocation (count + 1 entries) maps every old address to its new one,
+// label values stored outside of the code have to be moved with it.
+size_t mima_optimize_code(mima_word *instructions, uint32_t *lines, uint8_t *label_operands, size_t count, uint32_t *relocation);
+
+#endif // mima_optimizer_h
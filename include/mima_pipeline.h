@@ -0,0 +1,43 @@
+#ifndef mima_pipeline_h
+#define mima_pipeline_h
+
+#include "mima.h"
+
+// Three stage model of a pipelined Mima, fed with every retired instruction:
+//   IF - fetch mem[IAR]
+//   OF - decode, read ACC and the memory operand (ADD, AND, OR, XOR, EQL, LDV)
+//   EX - ALU, write ACC, STV writes memory, JMN resolves
+// Every stage takes one pipeline cycle. Hazards stall or flush:
+//   ACC RAW: OF reads ACC while the previous instruction still writes it in EX (1 stall, none with forwarding)
+//   memory RAW: OF reads the address the previous STV (or CALL) writes in EX (1 stall)
+//   JMP, CALL: target known in OF, the fetched successor is flushed (1 bubble)
+//   RET: target read from the stack in EX (2 bubbles)
+//   JMN: predicted not taken, a taken branch flushes IF and OF (2 bubbles)
+typedef struct _mima_pipeline
+{
+    mima_bool		forwarding;
+
+    // the previous instruction, one stage ahead
+    mima_bool		previous_writes_acc;
+    mima_bool		previous_stores;
+    mima_register	previous_store_address;
+
+    uint64_t		instructions;
+    uint64_t		cycles;
+    uint64_t		acc_stalls;
+    uint64_t		memory_stalls;
+    uint64_t		flushes;
+    uint64_t		jumps;
+    uint64_t		branches;
+    uint64_t		branches_taken;
+} mima_pipeline;
+
+mima_pipeline *mima_pipeline_create(mima_bool forwarding);
+void mima_pipeline_delete(mima_pipeline *pipeline);
+
+// called by both engines for every retired instruction
+void mima_pipeline_retire(mima_pipeline *pipeline, mima_t *mima);
+
+void mima_pipeline_print_stats(mima_pipeline *pipeline);
+
+#endif // mima_pipeline_h
@@ -0,0 +1,54 @@
+#ifndef mima_predictor_h
+#define mima_predictor_h
+
+#include "mima.h"
+
+// Branch predictor models for JMN, updated with every retired JMN:
+//   static - backward taken, forward not taken
+//   1bit   - last outcome per table entry
+//   2bit   - saturating counter per table entry
+//   gshare - 2 bit counters indexed by address ^ global history
+// Tables have 2^bits entries indexed by the branch address.
+typedef enum _mima_predictor_type
+{
+    MIMA_PREDICTOR_STATIC = 0,
+    MIMA_PREDICTOR_ONE_BIT,
+    MIMA_PREDICTOR_TWO_BIT,
+    MIMA_PREDICTOR_GSHARE
+} mima_predictor_type;
+
+typedef struct _mima_branch_stats
+{
+    mima_register	address;		// + 1, 0 = empty
+    uint64_t		executions;
+    uint64_t		taken;
+    uint64_t		mispredictions;
+} mima_branch_stats;
+
+typedef struct _mima_predictor
+{
+    mima_predictor_type	type;
+    uint32_t			bits;
+    uint8_t				*table;
+    uint32_t			history;
+
+    uint64_t			branches;
+    uint64_t			mispredictions;
+
+    // per branch address, open addressing
+    mima_branch_stats	*stats;
+    uint32_t			stats_capacity;
+    uint32_t			stats_count;
+} mima_predictor;
+
+// "static", "1bit", "2bit" or "gshare", optionally followed by ",bits" (default 12)
+mima_predictor *mima_predictor_create(const char *config);
+void mima_predictor_delete(mima_predictor *predictor);
+
+// Predicts, then learns the outcome. Returns mima_true on a misprediction.
+mima_bool mima_predictor_update(mima_predictor *predictor, mima_register address, mima_register target, mima_bool taken);
+
+// Aggregate numbers and the count branches with the most mispredictions.
+void mima_predictor_print_stats(mima_predictor *predictor, uint32_t count);
+
+#endif // mima_predictor_h
@@ -0,0 +1,31 @@
+#ifndef mima_preprocessor_h
+#define mima_preprocessor_h
+
+#include "mima.h"
+
+// Source level directives, expanded before the assembler sees the file:
+//
+//   .include "lib/print.asm"      paths are relative to the including file, every file is included once
+//   .macro NAME a b               defines NAME with the parameters a and b ...
+//   LDV \a                        ... used as \a and \b inside the body, \@ is unique per expansion
+//   .endm
+//   NAME 0x100 0x101              expands the body (arguments separated by blanks or commas)
+//
+// The expansion marks where its lines came from with "#line 12 "lib/print.asm"" (a comment to the assembler),
+// so diagnostics name the source file and line. Lines of a macro expansion are attributed to the macro call.
+//
+// Expanded translation units are cached in .mima_cache/ next to the source file.
+// A cache entry lists every file it was expanded from with its size, modification time and the hash of its content,
+// it is used as long as none of them changed. Only files with a new size or modification time are read and hashed.
+
+#define MIMA_PREPROCESSOR_MAX_DEPTH 32
+#define MIMA_PREPROCESSOR_MAX_PARAMS 8
+
+// NULL disables the cache, "" puts it next to the source file (the default).
+void mima_preprocessor_set_cache(const char *directory);
+
+// *expanded is NULL if the source has no directives, it can be assembled as it is.
+// Otherwise *expanded is the malloc()ed expansion of *expanded_size chars.
+mima_bool mima_preprocess_source(const char *file_name, const char *source, size_t size, char **expanded, size_t *expanded_size);
+
+#endif // mima_preprocessor_h
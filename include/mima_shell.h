@@ -6,8 +6,24 @@
 void mima_shell_print_help();
 void mima_shell_set_IAR(mima_t *mima, char *arg);
 void mima_shell_print_memory(mima_t *mima, char *arg);
+void mima_shell_reassemble(mima_t *mima, char *arg);
 void mima_shell_set_log_level(char *arg);
+char *mima_shell_match_command(char *input, const char *command);
+mima_bool mima_shell_take_option(char **arg, const char *option);
+void mima_shell_memory_dump(mima_t *mima, char *arg, mima_bool diff);
+int  mima_shell_parse_numbers(char *arg, uint32_t *numbers, int max);
+void mima_shell_find(mima_t *mima, char *arg);
+void mima_shell_fill(mima_t *mima, char *arg);
+void mima_shell_checksum(mima_t *mima, char *arg);
+void mima_shell_map_file(mima_t *mima, char *arg);
+void mima_shell_cache(mima_t *mima, char *arg);
+void mima_shell_branches(mima_t *mima, char *arg);
 int  mima_shell_execute_command(mima_t *mima, char *input);
 int  mima_shell(mima_t *mima);
 
+// batch mode never prompts, e.g. "r" after HLT just runs
+void mima_shell_set_batch_mode(mima_bool enabled);
+int  mima_shell_execute_line(mima_t *mima, char *line);
+int  mima_shell_run_script(mima_t *mima, const char *file_name);
+
 #endif // mima_shell_h
\ No newline at end of file
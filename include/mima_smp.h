@@ -0,0 +1,23 @@
+#ifndef mima_smp_h
+#define mima_smp_h
+
+#include "mima.h"
+
+// Several Mima cores on one memory (--cores N[,rr[,quantum]]).
+// Core 0 is the Mima the program was compiled into. The other cores are copies of it with their own control and
+// processing units that start at the same address, a program tells them apart by reading mima_core_id (0xC000005)
+// and mima_core_count (0xC000006). The CALL stack of core k starts MIMA_SMP_STACK_WORDS * k words below the top.
+//   default: every core runs on its own host thread, memory words are read and written atomically
+//            and stores are sequentially consistent
+//   rr:      the cores take turns on one thread, quantum instructions each (default 1),
+//            every run interleaves them the same way
+// Limits apply to every core on its own. The models, DMA, interrupts, record / replay and telemetry only
+// watch core 0.
+
+#define MIMA_SMP_MAX_CORES		64
+#define MIMA_SMP_STACK_WORDS	65536
+
+// Runs until every core stopped, then prints the instructions per core.
+mima_bool mima_smp_run(mima_t *mima, const char *config);
+
+#endif // mima_smp_h
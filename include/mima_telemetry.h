@@ -0,0 +1,55 @@
+#ifndef mima_telemetry_h
+#define mima_telemetry_h
+
+#include <pthread.h>
+#include "mima.h"
+
+// Machine readable counters for dashboards (--telemetry file[,ms]).
+// The engine publishes its counters into atomics every MIMA_TELEMETRY_INTERVAL instructions, when it stops
+// and before it waits for terminal input,
+// a sampling thread reads them every ms milliseconds (default 1000) and writes them into file:
+//   *.prom -> Prometheus text format, the whole file is replaced (textfile collector of the node exporter)
+//   else   -> one JSON object per line, appended
+// The sampling thread never touches the Mima itself, a slow disk does not slow down the engine.
+
+#define MIMA_TELEMETRY_INTERVAL 65536
+
+typedef struct _mima_telemetry_sample
+{
+    uint64_t			instructions;
+    uint64_t			micro_cycles;
+    uint64_t			cycles;
+    uint64_t			io_reads;
+    uint64_t			io_writes;
+    uint64_t			output_bytes;
+    uint32_t			pages;				// written at least once
+    uint32_t			stop_reason;
+} mima_telemetry_sample;
+
+typedef struct _mima_telemetry
+{
+    char					file_name[4096];
+    mima_bool				prometheus;
+    uint32_t				period;				// milliseconds
+    uint64_t				due;				// instruction count of the next mima_telemetry_publish()
+    mima_telemetry_sample	published;			// only accessed with __atomic_*
+
+    // sampling thread
+    pthread_t				thread;
+    pthread_mutex_t			mutex;
+    pthread_cond_t			condition;
+    mima_bool				quit;
+    mima_telemetry_sample	last;
+    uint64_t				last_time;
+    uint64_t				samples;
+} mima_telemetry;
+
+mima_telemetry *mima_telemetry_create(const char *config, mima_t *mima);
+
+// Publishes and writes a last sample.
+void mima_telemetry_delete(mima_telemetry *telemetry, mima_t *mima);
+
+// Called when an instruction retires and counters.instructions reached due.
+void mima_telemetry_publish(mima_telemetry *telemetry, mima_t *mima);
+
+#endif // mima_telemetry_h
@@ -0,0 +1,17 @@
+#ifndef mima_timing_h
+#define mima_timing_h
+
+#include "mima.h"
+
+// Default model: what the micro engine does (12 cycles, HLT 6, no I/O latency).
+void mima_timing_init(mima_timing *timing);
+
+// Loads "MNEMONIC cycles" lines plus "IO_READ cycles" / "IO_WRITE cycles" / "CACHE_MISS cycles"
+// on top of the current table.
+// Lines starting with '#' or '//' are comments.
+mima_bool mima_timing_load(mima_timing *timing, const char *file_name);
+
+// Per op code instructions and cycles of the timing model.
+void mima_timing_print_stats(mima_t *mima);
+
+#endif // mima_timing_h
@@ -0,0 +1,21 @@
+#ifndef mima_watchdog_h
+#define mima_watchdog_h
+
+#include "mima.h"
+
+// Per machine budgets (--limit instructions=#,seconds=#,pages=#,output=#).
+// The limits are checked when an instruction retires, but only every MIMA_WATCHDOG_INTERVAL instructions,
+// the instruction and output limits are exact. A machine over its budget stops with the matching mima_stop_reason
+// and stops again right away when it is started once more.
+
+#define MIMA_WATCHDOG_INTERVAL 4096
+
+// Replaces all limits, the wall time starts now.
+mima_bool mima_watchdog_set(mima_t *mima, const char *config);
+
+void mima_watchdog_check(mima_t *mima);
+void mima_watchdog_print(mima_t *mima);
+
+const char *mima_stop_reason_name(mima_stop_reason reason);
+
+#endif // mima_watchdog_h
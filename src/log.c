@@ -24,16 +24,25 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 #include "log.h"
 
+#define LOG_BINARY_MAGIC "MIMALOG1"
+#define LOG_MAX_SITE_ID (1u << 24) /* far more call sites than any build has, guards against corrupt files */
+
 static struct {
   void *udata;
   log_LockFn lock;
   FILE *fp;
   int level;
   int quiet;
+  unsigned long dropped;
+  FILE *binary;
+  unsigned generation;
+  unsigned sites;
 } L;
 
 
@@ -89,19 +98,16 @@ const char* log_get_level_name() {
   return level_names[L.level];
 }
 
+unsigned long log_get_dropped() {
+  return __atomic_load_n(&L.dropped, __ATOMIC_RELAXED);
+}
+
 void log_set_quiet(int enable) {
   L.quiet = enable ? 1 : 0;
 }
 
 
-void log_log(int level, const char *file, int line, const char *fmt, ...) {
-  if (level < L.level) {
-    return;
-  }
-
-  /* Acquire lock */
-  lock();
-
+static void log_text(int level, const char *file, int line, const char *fmt, va_list ap, int to_file) {
   /* Get current time */
   time_t t = time(NULL);
   struct tm *lt = localtime(&t);
@@ -118,26 +124,458 @@ void log_log(int level, const char *file, int line, const char *fmt, ...) {
 #else
     fprintf(stderr, "%s %-5s %s:%d: ", buf, level_names[level], file, line);
 #endif
-    va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
+    va_copy(args, ap);
+    int written = vfprintf(stderr, fmt, args);
     va_end(args);
-    fprintf(stderr, "\n");
-    fflush(stderr);
+    if (written < 0 || fprintf(stderr, "\n") < 0 || fflush(stderr) != 0) {
+      __atomic_fetch_add(&L.dropped, 1, __ATOMIC_RELAXED);
+    }
   }
 
   /* Log to file */
-  if (L.fp) {
+  if (L.fp && to_file) {
     va_list args;
     char buf[32];
     buf[strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", lt)] = '\0';
     fprintf(L.fp, "%s %-5s %s:%d: ", buf, level_names[level], file, line);
-    va_start(args, fmt);
-    vfprintf(L.fp, fmt, args);
+    va_copy(args, ap);
+    int written = vfprintf(L.fp, fmt, args);
     va_end(args);
-    fprintf(L.fp, "\n");
-    fflush(L.fp);
+    if (written < 0 || fprintf(L.fp, "\n") < 0 || fflush(L.fp) != 0) {
+      __atomic_fetch_add(&L.dropped, 1, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+
+void log_log(int level, const char *file, int line, const char *fmt, ...) {
+  if (level < L.level) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  lock();
+  log_text(level, file, line, fmt, args, 1);
+  unlock();
+  va_end(args);
+}
+
+
+/*
+ * Binary log
+ *
+ * "MIMALOG1", then records:
+ *   'D' u32 id, u8 level, u8 text, u32 line, u16 length + file, u16 length + format
+ *   'M' u32 id, u64 nanoseconds since the epoch, the arguments
+ * Integers and pointers take 8 bytes, doubles their 8 bytes, strings u32 length + bytes.
+ * Formats the decoder could not take apart (*, %n, long double, wide strings) are written
+ * as text, the message is then a single string.
+ */
+
+/* Kind per argument: lower case signed, upper case unsigned integers of
+ * int (i), char (b), short (h), long (l), long long (q), size_t (z), intmax_t (j), ptrdiff_t (t),
+ * f = double, s = string, p = pointer. Returns the number of arguments or -2. */
+static int log_parse_format(const char *fmt, char *kinds) {
+  int argc = 0;
+
+  for (const char *p = fmt; *p; p++) {
+    if (*p != '%') {
+      continue;
+    }
+    if (*++p == '%') {
+      continue;
+    }
+
+    p += strspn(p, "-+ #0'123456789.");
+    const char *length = p;
+    p += strspn(p, "hljzt");
+    size_t n = p - length;
+    char kind;
+
+    if (argc == LOG_MAX_ARGS || *p == '\0') {
+      return -2;
+    }
+
+    if (strchr("diuoxXc", *p)) {
+      static const char *lengths[] = { "", "hh", "h", "l", "ll", "z", "j", "t" };
+      static const char sizes[] = "ibhlqzjt";
+      int size = -1;
+      for (int i = 0; i < 8; i++) {
+        if (strlen(lengths[i]) == n && strncmp(length, lengths[i], n) == 0) {
+          size = i;
+        }
+      }
+      if (size < 0) {
+        return -2;
+      }
+      kind = sizes[size];
+      if (strchr("uoxX", *p)) {
+        kind -= 'a' - 'A';
+      }
+    } else if (strchr("feEgGaA", *p) && n == 0) {
+      kind = 'f';
+    } else if (*p == 's' && n == 0) {
+      kind = 's';
+    } else if (*p == 'p' && n == 0) {
+      kind = 'p';
+    } else {
+      return -2;
+    }
+
+    kinds[argc++] = kind;
+  }
+
+  return argc;
+}
+
+
+static uint64_t log_integer(char kind, va_list *ap) {
+  switch (kind) {
+    case 'i': return (int64_t)va_arg(*ap, int);
+    case 'I': return va_arg(*ap, unsigned);
+    case 'b': return (int64_t)(signed char)va_arg(*ap, int);
+    case 'B': return (unsigned char)va_arg(*ap, unsigned);
+    case 'h': return (int64_t)(short)va_arg(*ap, int);
+    case 'H': return (unsigned short)va_arg(*ap, unsigned);
+    case 'l': return (int64_t)va_arg(*ap, long);
+    case 'L': return va_arg(*ap, unsigned long);
+    case 'q': return (int64_t)va_arg(*ap, long long);
+    case 'Q': return va_arg(*ap, unsigned long long);
+    case 'z': return (int64_t)(intptr_t)va_arg(*ap, size_t);
+    case 'Z': return va_arg(*ap, size_t);
+    case 'j': return (int64_t)va_arg(*ap, intmax_t);
+    case 'J': return va_arg(*ap, uintmax_t);
+    case 't': case 'T': return (int64_t)va_arg(*ap, ptrdiff_t);
+    default: return (uintptr_t)va_arg(*ap, void *);
+  }
+}
+
+
+static int log_put(const void *data, size_t size) {
+  return fwrite(data, 1, size, L.binary) == size;
+}
+
+
+static int log_put_string(const char *string, size_t length) {
+  uint32_t size = length;
+  return log_put(&size, sizeof(size)) && log_put(string, size);
+}
+
+
+static int log_define(log_Site *site, const char *fmt) {
+  uint8_t tag = 'D', level = site->level, text = site->argc == -2;
+  uint32_t id = site->id, line = site->line;
+  uint16_t file_length = strlen(site->file), fmt_length = strlen(fmt);
+
+  return log_put(&tag, 1) && log_put(&id, 4) && log_put(&level, 1) && log_put(&text, 1) && log_put(&line, 4) &&
+         log_put(&file_length, 2) && log_put(site->file, file_length) && log_put(&fmt_length, 2) && log_put(fmt, fmt_length);
+}
+
+
+static void log_binary(log_Site *site, const char *fmt, va_list ap) {
+  if (site->argc == -1) {
+    site->argc = log_parse_format(fmt, site->kinds);
+  }
+
+  /* ids are handed out lazily, a site that never logs costs nothing */
+  if (!site->id) {
+    site->id = ++L.sites;
+  }
+
+  int ok = 1;
+
+  if (site->defined != L.generation) {
+    ok = log_define(site, fmt);
+    site->defined = L.generation;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  uint8_t tag = 'M';
+  uint32_t id = site->id;
+  uint64_t time = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  ok = ok && log_put(&tag, 1) && log_put(&id, 4) && log_put(&time, 8);
+
+  va_list args;
+  va_copy(args, ap);
+
+  if (site->argc == -2) {
+    char buf[1024];
+    int length = vsnprintf(buf, sizeof(buf), fmt, args);
+    ok = ok && length >= 0 && log_put_string(buf, length < (int)sizeof(buf) ? (size_t)length : sizeof(buf) - 1);
+  }
+
+  for (int i = 0; i < site->argc && ok; i++) {
+    if (site->kinds[i] == 's') {
+      const char *string = va_arg(args, const char *);
+      if (!string) {
+        string = "(null)";
+      }
+      ok = log_put_string(string, strlen(string));
+    } else if (site->kinds[i] == 'f') {
+      double value = va_arg(args, double);
+      ok = log_put(&value, 8);
+    } else {
+      uint64_t value = log_integer(site->kinds[i], &args);
+      ok = log_put(&value, 8);
+    }
+  }
+
+  va_end(args);
+
+  if (!ok) {
+    __atomic_fetch_add(&L.dropped, 1, __ATOMIC_RELAXED);
+  }
+}
+
+
+void log_log_site(log_Site *site, const char *fmt, ...) {
+  if (site->level < L.level) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  lock();
+
+  if (L.binary) {
+    log_binary(site, fmt, args);
+    if (site->level >= LOG_WARN) {
+      log_text(site->level, site->file, site->line, fmt, args, 0);
+    }
+  } else {
+    log_text(site->level, site->file, site->line, fmt, args, 1);
+  }
+
+  unlock();
+  va_end(args);
+}
+
+
+int log_set_binary(const char *path) {
+  lock();
+
+  if (L.binary) {
+    fclose(L.binary);
+    L.binary = NULL;
+  }
+
+  if (path) {
+    L.binary = fopen(path, "wb");
+    if (L.binary) {
+      setvbuf(L.binary, NULL, _IOFBF, 1 << 20);
+      fwrite(LOG_BINARY_MAGIC, 1, 8, L.binary);
+      L.generation++;
+    }
   }
 
-  /* Release lock */
   unlock();
+  return path && !L.binary ? -1 : 0;
+}
+
+
+typedef struct {
+  int level;
+  int text;
+  int line;
+  char *file;
+  char *fmt;
+  int argc;
+  char kinds[LOG_MAX_ARGS];
+} log_Definition;
+
+
+static int log_get(FILE *in, void *data, size_t size) {
+  return fread(data, 1, size, in) == size;
+}
+
+
+static char *log_get_string(FILE *in, size_t length) {
+  char *string = malloc(length + 1);
+  if (string && !log_get(in, string, length)) {
+    free(string);
+    return NULL;
+  }
+  if (string) {
+    string[length] = '\0';
+  }
+  return string;
+}
+
+
+/* Prints fmt with the arguments of one message, every conversion on its own */
+static void log_print(FILE *out, const char *fmt, const uint64_t *values, char **strings) {
+  int arg = 0;
+
+  for (const char *p = fmt; *p; p++) {
+    if (*p != '%') {
+      fputc(*p, out);
+      continue;
+    }
+    if (p[1] == '%') {
+      fputc('%', out);
+      p++;
+      continue;
+    }
+
+    char spec[32] = "%";
+    size_t flags = strspn(p + 1, "-+ #0'123456789.");
+    if (flags > sizeof(spec) - 5) {
+      flags = sizeof(spec) - 5;
+    }
+    strncat(spec, p + 1, flags);
+    p += 1 + flags;
+    p += strspn(p, "hljzt");
+    uint64_t value = values[arg];
+
+    if (strchr("di", *p)) {
+      strcat(spec, "ll");
+      strncat(spec, p, 1);
+      fprintf(out, spec, (long long)value);
+    } else if (strchr("uoxX", *p)) {
+      strcat(spec, "ll");
+      strncat(spec, p, 1);
+      fprintf(out, spec, (unsigned long long)value);
+    } else if (*p == 'c') {
+      strcat(spec, "c");
+      fprintf(out, spec, (int)value);
+    } else if (*p == 's') {
+      strcat(spec, "s");
+      fprintf(out, spec, strings[arg]);
+    } else if (*p == 'p') {
+      strcat(spec, "p");
+      fprintf(out, spec, (void *)(uintptr_t)value);
+    } else {
+      double number;
+      memcpy(&number, &value, sizeof(number));
+      strncat(spec, p, 1);
+      fprintf(out, spec, number);
+    }
+
+    arg++;
+  }
+}
+
+
+int log_decode(const char *path, FILE *out) {
+  FILE *in = fopen(path, "rb");
+  char magic[8];
+
+  if (!in) {
+    return -1;
+  }
+  if (!log_get(in, magic, sizeof(magic)) || memcmp(magic, LOG_BINARY_MAGIC, sizeof(magic)) != 0) {
+    fclose(in);
+    return -1;
+  }
+
+  log_Definition *definitions = NULL;
+  uint32_t capacity = 0;
+  int result = 0;
+  uint8_t tag;
+
+  while (log_get(in, &tag, 1)) {
+    uint32_t id;
+
+    if (!log_get(in, &id, 4)) {
+      result = -1;
+      break;
+    }
+
+    if (tag == 'D') {
+      uint8_t level, text;
+      uint32_t line;
+      uint16_t file_length, fmt_length;
+      char *file = NULL, *fmt = NULL;
+
+      if (id > LOG_MAX_SITE_ID || !log_get(in, &level, 1) || !log_get(in, &text, 1) || !log_get(in, &line, 4) || level > LOG_FATAL ||
+          !log_get(in, &file_length, 2) || !(file = log_get_string(in, file_length)) ||
+          !log_get(in, &fmt_length, 2) || !(fmt = log_get_string(in, fmt_length))) {
+        free(file);
+        result = -1;
+        break;
+      }
+
+      if (id >= capacity) {
+        size_t grown = (size_t)id * 2 + 16;
+        log_Definition *bigger = realloc(definitions, grown * sizeof(log_Definition));
+        if (!bigger) {
+          free(file);
+          free(fmt);
+          result = -1;
+          break;
+        }
+        memset(&bigger[capacity], 0, (grown - capacity) * sizeof(log_Definition));
+        definitions = bigger;
+        capacity = grown;
+      }
+
+      log_Definition *definition = &definitions[id];
+      free(definition->file);
+      free(definition->fmt);
+      definition->level = level;
+      definition->text = text;
+      definition->line = line;
+      definition->file = file;
+      definition->fmt = fmt;
+      definition->argc = text ? 1 : log_parse_format(fmt, definition->kinds);
+      if (text) {
+        definition->kinds[0] = 's';
+      }
+      continue;
+    }
+
+    uint64_t time;
+
+    if (tag != 'M' || id >= capacity || !definitions[id].fmt || !log_get(in, &time, 8)) {
+      result = -1;
+      break;
+    }
+
+    log_Definition *definition = &definitions[id];
+    uint64_t values[LOG_MAX_ARGS] = {0};
+    char *strings[LOG_MAX_ARGS] = {0};
+    int complete = definition->argc >= 0;
+
+    for (int i = 0; i < definition->argc && complete; i++) {
+      uint32_t length;
+      if (definition->kinds[i] != 's') {
+        complete = log_get(in, &values[i], 8);
+      } else {
+        complete = log_get(in, &length, 4) && (strings[i] = log_get_string(in, length)) != NULL;
+      }
+    }
+
+    if (complete) {
+      time_t seconds = time / 1000000000;
+      char buf[32];
+      buf[strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&seconds))] = '\0';
+      fprintf(out, "%s %-5s %s:%d: ", buf, level_names[definition->level], definition->file, definition->line);
+      if (definition->text) {
+        fputs(strings[0], out);
+      } else {
+        log_print(out, definition->fmt, values, strings);
+      }
+      fputc('\n', out);
+    }
+
+    for (int i = 0; i < LOG_MAX_ARGS; i++) {
+      free(strings[i]);
+    }
+
+    if (!complete) {
+      result = -1;
+      break;
+    }
+  }
+
+  for (uint32_t i = 0; i < capacity; i++) {
+    free(definitions[i].file);
+    free(definitions[i].fmt);
+  }
+  free(definitions);
+  fclose(in);
+
+  return result;
 }
@@ -1,21 +1,321 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include "mima.h"
+#include "mima_debug_server.h"
+#include "mima_devices.h"
+#include "mima_timing.h"
+#include "mima_pipeline.h"
+#include "mima_cache.h"
+#include "mima_predictor.h"
+#include "mima_iolog.h"
+#include "mima_analysis.h"
+#include "mima_preprocessor.h"
+#include "mima_optimizer.h"
+#include "mima_checkpoint.h"
+#include "mima_watchdog.h"
+#include "mima_telemetry.h"
+#include "mima_smp.h"
+#include "mima_interrupts.h"
+#include "mima_shell.h"
 #include "log.h"
 
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// the assembler logs from multiple threads
+static void log_lock(void *udata, int lock)
+{
+    (void)udata;
+
+    if (lock)
+        pthread_mutex_lock(&log_mutex);
+    else
+        pthread_mutex_unlock(&log_mutex);
+}
+
+static void print_usage(const char *program)
+{
+    printf("Usage: %s [options] file.asm\n", program);
+    printf("  --debug-server endpoint   serve the debug protocol on a TCP port (127.0.0.1) or Unix socket path\n");
+    printf("  --dma cycles              enable the DMA controller, charging cycles micro cycles per copied word\n");
+    printf("  --interrupts              enable the interrupt controller, the timer and input without waiting\n");
+    printf("  --map-file file@addr[:#]  map a host file read-only into # words of guest memory at addr\n");
+    printf("  --timing file             load the cycle costs of the timing model (see timing.cfg)\n");
+    printf("  --pipeline stall|forward  run the pipeline model along, with or without ACC forwarding\n");
+    printf("  --cache size,ways,line[,wb|wt]\n");
+    printf("                            run a cache model (sizes in words) in front of memory\n");
+    printf("  --predictor static|1bit|2bit|gshare[,bits]\n");
+    printf("                            run a branch predictor model for JMN\n");
+    printf("  --extended-isa            enable MUL, SUB, SHL, SHR, LDIV, STIV, CALL and RET\n");
+    printf("  --record file             record every terminal input into file\n");
+    printf("  --replay file             feed the inputs recorded in file back instead of reading stdin\n");
+    printf("  --optimize                remove redundant STV/LDV, LDC 0/ADD and NOT/NOT sequences\n");
+    printf("  --asm-cache dir|off       where expanded .include / .macro sources are cached (default .mima_cache)\n");
+    printf("  --checkpoint file[,every[s][,keep]]\n");
+    printf("                            write a checkpoint every # instructions (or seconds) into keep rotating files\n");
+    printf("  --resume file             continue from the newest checkpoint written with --checkpoint file\n");
+    printf("  --telemetry file[,ms]     write counters every ms (1000) as JSON lines, or Prometheus text into *.prom\n");
+    printf("  --binary-log file         write trace messages into file as raw arguments (implies level TRACE)\n");
+    printf("  --decode-log file         print a binary log as text, then quit\n");
+    printf("  --cores N[,rr[,quantum]]  run N cores on the memory first, on threads or taking turns (rr)\n");
+    printf("  --limit spec              stop after instructions=#,seconds=#,pages=#,output=# (exit status 3)\n");
+    printf("  --check                   analyze the control flow first, do not run a program with errors\n");
+    printf("  --script file             run the shell commands in file, then quit\n");
+    printf("  -c \"cmd;cmd;...\"          run the given shell commands, then quit\n");
+}
+
+// file@address[:words]
+static mima_bool map_file(mima_t *mima, char *argument)
+{
+    char *at = strrchr(argument, '@');
+
+    if (!at)
+    {
+        printf("Expected file@address[:words], got %s\n", argument);
+        return mima_false;
+    }
+
+    *at = 0;
+
+    char *endptr;
+    mima_register address = strtoul(at + 1, &endptr, 0);
+    uint32_t words = *endptr == ':' ? strtoul(endptr + 1, NULL, 0) : 0;
+
+    return mima_device_map_file(mima, argument, address, words);
+}
+
 int main(int argc, char **argv)
 {
+    const char *fileName = NULL;
+    const char *debugEndpoint = NULL;
+    const char *scriptFile = NULL;
+    char *commands = NULL;
+    char *dmaCycles = NULL;
+    mima_bool interrupts = mima_false;
+    char *timingFile = NULL;
+    char *pipelineMode = NULL;
+    char *cacheConfig = NULL;
+    char *predictorConfig = NULL;
+    char *ioLogFile = NULL;
+    mima_bool ioLogReplay = mima_false;
+    mima_bool check = mima_false;
+    char *checkpointConfig = NULL;
+    char *resumeFile = NULL;
+    char *limitConfig = NULL;
+    char *telemetryConfig = NULL;
+    char *binaryLogFile = NULL;
+    char *coresConfig = NULL;
+    char *mapFiles[16];
+    int mapFilesCount = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--debug-server") == 0 && i + 1 < argc)
+        {
+            debugEndpoint = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dma") == 0 && i + 1 < argc)
+        {
+            dmaCycles = argv[++i];
+        }
+        else if (strcmp(argv[i], "--interrupts") == 0)
+        {
+            interrupts = mima_true;
+        }
+        else if (strcmp(argv[i], "--map-file") == 0 && i + 1 < argc && mapFilesCount < 16)
+        {
+            mapFiles[mapFilesCount++] = argv[++i];
+        }
+        else if (strcmp(argv[i], "--timing") == 0 && i + 1 < argc)
+        {
+            timingFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc)
+        {
+            pipelineMode = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            cacheConfig = argv[++i];
+        }
+        else if (strcmp(argv[i], "--predictor") == 0 && i + 1 < argc)
+        {
+            predictorConfig = argv[++i];
+        }
+        else if (strcmp(argv[i], "--extended-isa") == 0)
+        {
+            mima_extended_isa = mima_true;
+        }
+        else if ((strcmp(argv[i], "--record") == 0 || strcmp(argv[i], "--replay") == 0) && i + 1 < argc)
+        {
+            ioLogReplay = strcmp(argv[i], "--replay") == 0;
+            ioLogFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--optimize") == 0)
+        {
+            mima_optimize = mima_true;
+        }
+        else if (strcmp(argv[i], "--asm-cache") == 0 && i + 1 < argc)
+        {
+            i++;
+            mima_preprocessor_set_cache(strcmp(argv[i], "off") == 0 ? NULL : argv[i]);
+        }
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+        {
+            checkpointConfig = argv[++i];
+        }
+        else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc)
+        {
+            resumeFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc)
+        {
+            limitConfig = argv[++i];
+        }
+        else if (strcmp(argv[i], "--binary-log") == 0 && i + 1 < argc)
+        {
+            binaryLogFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--decode-log") == 0 && i + 1 < argc)
+        {
+            if (log_decode(argv[++i], stdout) != 0)
+            {
+                fprintf(stderr, "%s is not a complete binary log :(\n", argv[i]);
+                return -1;
+            }
+
+            return 0;
+        }
+        else if (strcmp(argv[i], "--cores") == 0 && i + 1 < argc)
+        {
+            coresConfig = argv[++i];
+        }
+        else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc)
+        {
+            telemetryConfig = argv[++i];
+        }
+        else if (strcmp(argv[i], "--check") == 0)
+        {
+            check = mima_true;
+        }
+        else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+        {
+            scriptFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            commands = argv[++i];
+        }
+        else if (argv[i][0] == '-')
+        {
+            print_usage(argv[0]);
+            return -1;
+        }
+        else
+        {
+            fileName = argv[i];
+        }
+    }
 
-    if(argc < 2)
+    if(!fileName)
     {
         printf("Provide mima source code file as parameter... \n");
+        print_usage(argv[0]);
         return -1;
     }
 
-    const char *fileName = argv[1];
+    if (coresConfig && debugEndpoint)
+    {
+        printf("The debug server only knows a single core :(\n");
+        return -1;
+    }
+
+    // when input arrives is up to the host, a replay could not deliver it at the same instruction
+    if (interrupts && ioLogFile)
+    {
+        printf("--record and --replay do not work with --interrupts :(\n");
+        return -1;
+    }
 
     mima_t mima = mima_init();
 
-    log_set_level(LOG_TRACE);
+    mima_bool batch = scriptFile || commands;
+
+    // a headless server, script or several cores would drown in micro cycle traces
+    log_set_level(debugEndpoint || batch || coresConfig ? LOG_WARN : LOG_TRACE);
+    log_set_lock(log_lock);
+
+    // the binary log is meant for the micro cycle traces
+    if (binaryLogFile)
+    {
+        if (log_set_binary(binaryLogFile) != 0)
+        {
+            printf("Failed to open %s :(\n", binaryLogFile);
+            return -1;
+        }
+
+        log_set_level(LOG_TRACE);
+    }
+
+    if (timingFile && !mima_timing_load(&mima.timing, timingFile))
+    {
+        return -1;
+    }
+
+    if (pipelineMode)
+    {
+        if (strcmp(pipelineMode, "stall") != 0 && strcmp(pipelineMode, "forward") != 0)
+        {
+            print_usage(argv[0]);
+            return -1;
+        }
+
+        mima.pipeline = mima_pipeline_create(strcmp(pipelineMode, "forward") == 0);
+    }
+
+    if (cacheConfig && !(mima.cache = mima_cache_create(cacheConfig)))
+    {
+        return -1;
+    }
+
+    if (predictorConfig && !(mima.predictor = mima_predictor_create(predictorConfig)))
+    {
+        return -1;
+    }
+
+    if (ioLogFile && !(mima.io_log = mima_io_log_open(ioLogFile, ioLogReplay)))
+    {
+        return -1;
+    }
+
+    if (checkpointConfig && !(mima.checkpoint = mima_checkpoint_create(checkpointConfig, &mima)))
+    {
+        return -1;
+    }
+
+    if (telemetryConfig && !(mima.telemetry = mima_telemetry_create(telemetryConfig, &mima)))
+    {
+        return -1;
+    }
+
+    if (dmaCycles)
+    {
+        mima_device_dma_enable(&mima, strtoul(dmaCycles, NULL, 0));
+    }
+
+    if (interrupts)
+    {
+        mima_interrupts_enable(&mima);
+    }
+
+    for (int i = 0; i < mapFilesCount; ++i)
+    {
+        if (!map_file(&mima, mapFiles[i]))
+        {
+            return -1;
+        }
+    }
 
     if (!mima_compile(&mima, fileName))
     {
@@ -23,9 +323,57 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    mima_run(&mima, mima_true);
+    if (resumeFile && !mima_checkpoint_resume(&mima, resumeFile))
+    {
+        mima_delete(&mima);
+        return -1;
+    }
+
+    if (check && mima_analyze_image().errors > 0)
+    {
+        printf("%s did not pass the analysis :(\n", fileName);
+        mima_delete(&mima);
+        return 2;
+    }
+
+    if (limitConfig && !mima_watchdog_set(&mima, limitConfig))
+    {
+        mima_delete(&mima);
+        return -1;
+    }
+
+    // the cores run first, the shell can look at the result
+    if (coresConfig && !mima_smp_run(&mima, coresConfig))
+    {
+        mima_delete(&mima);
+        return -1;
+    }
+
+    if (debugEndpoint)
+    {
+        mima_debug_server_run(&mima, debugEndpoint);
+    }
+    else if (batch)
+    {
+        mima_shell_set_batch_mode(mima_true);
+
+        if (!scriptFile || mima_shell_run_script(&mima, scriptFile))
+        {
+            if (commands)
+            {
+                mima_shell_execute_line(&mima, commands);
+            }
+        }
+    }
+    else
+    {
+        mima_run(&mima, mima_true);
+    }
 
+    // lets a batch server tell runaway programs from finished ones
+    int status = mima.stop_reason >= MIMA_STOP_INSTRUCTIONS ? 3 : 0;
     mima_delete(&mima);
+    log_set_binary(NULL);
 
-    return 0;
-}
\ No newline at end of file
+    return status;
+}
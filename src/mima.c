@@ -6,7 +6,21 @@
 
 #include "mima.h"
 #include "mima_compiler.h"
+#include "mima_devices.h"
+#include "mima_memory.h"
+#include "mima_pipeline.h"
+#include "mima_cache.h"
+#include "mima_predictor.h"
+#include "mima_iolog.h"
+#include "mima_checkpoint.h"
+#include "mima_telemetry.h"
+#include "mima_interrupts.h"
+#include "mima_watchdog.h"
+#include "mima_disassembler.h"
 #include "mima_shell.h"
+#include "mima_timing.h"
+
+mima_bool mima_extended_isa = mima_false;
 
 mima_t mima_init()
 {
@@ -16,6 +30,7 @@ mima_t mima_init()
             .IR  = 0,
             .IAR = 0,
             .IP  = 0,
+            .SP  = mima_words,
             .TRA = 0,
             .RUN = mima_true
         },
@@ -31,13 +46,20 @@ mima_t mima_init()
             .Y   = 0,
             .Z   = 0,
             .MICRO_CYCLE = 1 // 1 - 12 cycles per instruction
-        }
+        },
+        .interrupts = {
+            .due = UINT64_MAX
+        },
+        .limits = {
+            .due = UINT64_MAX
+        },
+        .cores = 1
     };
 
-    // we allocate mima words aka 32 Bit integers
-    mima.memory_unit.memory = malloc(mima_words * sizeof(mima_word));
+    mima_timing_init(&mima.timing);
 
-    if(!mima.memory_unit.memory)
+    // we allocate mima words aka 32 Bit integers
+    if(!mima_memory_init(&mima.memory_unit))
     {
         log_fatal("Could not allocate Mima memory :(\n");
         assert(0);
@@ -63,11 +85,8 @@ void mima_run(mima_t *mima, mima_bool interactive)
     }
     else
     {
-        while(mima->control_unit.RUN)
-        {
-            mima_micro_instruction_step(mima);
-            // do not check for breakpoints here -> it's non interactive mode
-        }
+        // do not check for breakpoints here -> it's non interactive mode
+        mima_run_fast(mima, UINT64_MAX);
     }
 }
 
@@ -94,10 +113,21 @@ void mima_run_instruction_steps(mima_t *mima, char *arg)
     }
 
 
-    steps *= 12; // 12 micro step = 1 instruction
+    // micro cycle traces are only available in the micro engine
+    if (log_get_level() > LOG_TRACE)
+    {
+        mima_run_fast(mima, steps);
+        return;
+    }
+
+    // HLT ends early -> count instructions, not 12 micro steps each
     while( (steps--) && mima->control_unit.RUN )
     {
-        mima_micro_instruction_step(mima);
+        do
+        {
+            mima_micro_instruction_step(mima);
+        }
+        while (mima->processing_unit.MICRO_CYCLE != 1 && mima->control_unit.RUN);
 
         // TODO: check breakpoints
     }
@@ -123,13 +153,18 @@ void mima_run_micro_instruction_steps(mima_t *mima, char *arg)
 
 mima_bool mima_compile(mima_t *mima, const char *file_name)
 {
-    return mima_compile_file(mima, file_name);
+    mima_bool result = mima_compile_file(mima, file_name);
+
+    // "memdiff" shows what the program changed, not what the assembler wrote
+    mima_memory_reset_baseline(&mima->memory_unit);
+
+    return result;
 }
 
 mima_instruction mima_instruction_decode(mima_t *mima)
 {
 
-    mima_word mem = mima->memory_unit.memory[mima->memory_unit.SAR];
+    mima_word mem = mima_memory_read(&mima->memory_unit, mima->memory_unit.SAR);
 
     mima_instruction instr;
 
@@ -146,6 +181,13 @@ mima_instruction mima_instruction_decode(mima_t *mima)
         instr.op_code   = mem >> 24;
         instr.value     = mem & 0x00FFFFFF;
         instr.extended  = mima_true;
+
+        // without --extended-isa MUL - RET are as invalid as any other unknown op code
+        if (instr.op_code >= MUL && !mima_extended_isa)
+        {
+            log_warn("%s needs --extended-isa", mima_get_instruction_name(instr.op_code));
+            instr.op_code = 0xFF;
+        }
     }
 
     return instr;
@@ -158,6 +200,59 @@ mima_bool mima_sar_external(mima_t *mima)
     return mima_false;
 }
 
+// every access to general purpose memory, both engines
+static inline void mima_cache_hook(mima_t *mima, mima_register address, mima_bool write)
+{
+    if (mima->cache && !mima_cache_access(mima->cache, address, write))
+    {
+        mima->counters.cycles += mima->timing.cache_miss_latency;
+    }
+}
+
+// both engines account a finished instruction here
+static inline void mima_retire_instruction(mima_t *mima)
+{
+    uint32_t slot = mima_op_slot(mima->current_instruction.op_code);
+
+    mima->counters.instructions++;
+    mima->counters.op_instructions[slot]++;
+    mima->counters.cycles += mima->timing.cycles[slot];
+
+    if (mima->pipeline)
+    {
+        mima_pipeline_retire(mima->pipeline, mima);
+    }
+
+    // JMN leaves SAR at its own address and ACC untouched
+    if (mima->predictor && mima->current_instruction.op_code == JMN)
+    {
+        mima_predictor_update(mima->predictor, mima->memory_unit.SAR, mima->current_instruction.value, (int32_t)mima->processing_unit.ACC < 0);
+    }
+
+    if (mima->counters.instructions >= mima->limits.due)
+    {
+        mima_watchdog_check(mima);
+    }
+
+    // interrupts are only taken between two instructions
+    if (mima->counters.instructions >= __atomic_load_n(&mima->interrupts.due, __ATOMIC_RELAXED))
+    {
+        mima_interrupts_check(mima);
+    }
+
+    // retiring is an instruction boundary in both engines
+    if (mima->checkpoint && mima->counters.instructions >= mima->checkpoint->due)
+    {
+        mima_checkpoint_tick(mima->checkpoint, mima);
+    }
+
+    // a stopped Mima is published right away, it may sit at the shell for a long time
+    if (mima->telemetry && (mima->counters.instructions >= mima->telemetry->due || !mima->control_unit.RUN))
+    {
+        mima_telemetry_publish(mima->telemetry, mima);
+    }
+}
+
 void mima_micro_instruction_step(mima_t *mima)
 {
     //FETCH: first 5 cycles are the same for all instructions
@@ -183,12 +278,18 @@ void mima_micro_instruction_step(mima_t *mima)
         mima->control_unit.IAR = mima->processing_unit.Z;
         log_trace("Fetch - %02d: Z -> IAR \t\t\t 0x%08x -> IAR", mima->processing_unit.MICRO_CYCLE, mima->processing_unit.Z);
         mima->current_instruction = mima_instruction_decode(mima);
-        mima->memory_unit.SIR = mima->memory_unit.memory[mima->memory_unit.SAR];
+        mima_cache_hook(mima, mima->memory_unit.SAR, mima_false);
+        mima->memory_unit.SIR = mima_memory_read(&mima->memory_unit, mima->memory_unit.SAR);
         log_trace("Fetch - %02d: mem[SAR] -> SIR \t\t mem[0x%08x] -> SIR \t I/O Read done", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
         break;
     case 5:
         mima->control_unit.IR = mima->memory_unit.SIR;
-        log_trace("Fetch - %02d: SIR -> IR \t\t\t 0x%08x -> IR", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SIR);
+
+        // only disassemble when somebody reads it
+        if (log_get_level() <= LOG_TRACE)
+        {
+            log_trace("Fetch - %02d: SIR -> IR \t\t\t 0x%08x -> IR \t %s", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SIR, mima_disassemble(mima->memory_unit.SAR, mima->memory_unit.SIR));
+        }
         break;
     default:
     {
@@ -228,6 +329,26 @@ void mima_micro_instruction_step(mima_t *mima)
         case RRN:
             mima_instruction_RRN(mima);
             break;
+        case MUL:
+        case SUB:
+            mima_instruction_common(mima);
+            break;
+        case SHL:
+        case SHR:
+            mima_instruction_SHIFT(mima);
+            break;
+        case LDIV:
+            mima_instruction_LDIV(mima);
+            break;
+        case STIV:
+            mima_instruction_STIV(mima);
+            break;
+        case CALL:
+            mima_instruction_CALL(mima);
+            break;
+        case RET:
+            mima_instruction_RET(mima);
+            break;
         default:
             log_warn("Invalid instruction - nr.%d - :(\n", mima->current_instruction.op_code);
             assert(0);
@@ -240,6 +361,505 @@ void mima_micro_instruction_step(mima_t *mima)
     {
         mima->processing_unit.MICRO_CYCLE = 1;
     }
+
+    mima->counters.micro_cycles++;
+    if (mima->processing_unit.MICRO_CYCLE == 1)
+    {
+        mima_retire_instruction(mima);
+    }
+}
+
+static mima_bool mima_io_device_read(mima_t *mima, mima_register address, mima_word *value)
+{
+    if (mima->dma.enabled && address >= mima_dma_source && address <= mima_dma_start)
+    {
+        return mima_device_dma_read(mima, address, value);
+    }
+
+    if (mima->interrupts.enabled && address >= mima_irq_vector && address <= mima_input_data)
+    {
+        return mima_interrupts_read(mima, address, value);
+    }
+
+    // cores tell each other apart by their number
+    if (address == mima_core_id || address == mima_core_count)
+    {
+        *value = address == mima_core_id ? mima->core : mima->cores;
+        return mima_true;
+    }
+
+    if (address != mima_char_input && address != mima_integer_input)
+    {
+        return mima_false;
+    }
+
+    mima_io_log *io_log = mima->io_log;
+
+    if (io_log && io_log->replay)
+    {
+        if (!mima_io_log_replay(io_log, mima->counters.instructions, address, value))
+        {
+            // never fall back to stdin, the run would not be reproducible anymore
+            *value = 0;
+            mima->control_unit.RUN = mima_false;
+            mima->stop_reason = MIMA_STOP_INPUT;
+        }
+
+        return mima_true;
+    }
+
+    // the program may wait for a long time
+    if (mima->telemetry)
+    {
+        mima_telemetry_publish(mima->telemetry, mima);
+    }
+
+    if (address == mima_char_input)
+    {
+        printf("Waiting for single char:");
+        *value = (char)mima_input_getchar(mima);
+    }
+    else
+    {
+        printf("Waiting for number (dec or hex [with 0x-prefix]):");
+        char number_string[32] = {0};
+        char* endptr;
+
+        mima_input_gets(mima, number_string, 31);
+
+        *value = strtol(number_string, &endptr, 0);
+    }
+
+    if (io_log)
+    {
+        mima_io_log_record(io_log, mima->counters.instructions, address, *value);
+    }
+
+    return mima_true;
+}
+
+static mima_bool mima_io_device_write(mima_t *mima, mima_register address, mima_word value)
+{
+    if (mima->dma.enabled && address >= mima_dma_source && address <= mima_dma_start)
+    {
+        return mima_device_dma_write(mima, address, value);
+    }
+
+    if (mima->interrupts.enabled && address >= mima_irq_vector && address <= mima_input_data)
+    {
+        return mima_interrupts_write(mima, address, value);
+    }
+
+    // writing to IO -> ignoring the  first 4 bits
+    int written = -1;
+
+    if (address == mima_char_output)
+    {
+        written = printf("%c\n", value & 0x0FFFFFFF);
+    }
+    else if (address == mima_integer_output)
+    {
+        written = printf("%d\n", value & 0x0FFFFFFF);
+    }
+    else
+    {
+        return mima_false;
+    }
+
+    if (written > 0)
+    {
+        mima->counters.output_bytes += written;
+
+        // output is rare, so its budget is checked when this instruction retires
+        if (mima->limits.output_bytes && mima->counters.output_bytes > mima->limits.output_bytes)
+        {
+            mima->limits.due = mima->counters.instructions;
+        }
+    }
+
+    return mima_true;
+}
+
+// I/O latency of the timing model is only charged for devices that answer
+mima_bool mima_io_read(mima_t *mima, mima_register address, mima_word *value)
+{
+    if (!mima_io_device_read(mima, address, value))
+    {
+        return mima_false;
+    }
+
+    mima->counters.io_reads++;
+    mima->counters.cycles += mima->timing.io_read_latency;
+    return mima_true;
+}
+
+mima_bool mima_io_write(mima_t *mima, mima_register address, mima_word value)
+{
+    if (!mima_io_device_write(mima, address, value))
+    {
+        return mima_false;
+    }
+
+    mima->counters.io_writes++;
+    mima->counters.cycles += mima->timing.io_write_latency;
+    return mima_true;
+}
+
+static inline mima_word mima_rotate_right(mima_word value, mima_word amount)
+{
+    int32_t shifted = value >> amount;
+    int32_t rotated = value << (32 - amount);
+    return shifted | rotated;
+}
+
+static inline mima_word mima_shift(mima_instruction_type op_code, mima_word value, mima_word amount)
+{
+    if (amount >= 32)
+    {
+        return 0;
+    }
+
+    return op_code == SHL ? value << amount : value >> amount;
+}
+
+// an invalid access of the program stops the Mima like HLT does
+static void mima_stop_error(mima_t *mima)
+{
+    mima->control_unit.RUN = mima_false;
+    mima->stop_reason = MIMA_STOP_ERROR;
+}
+
+// LDIV: SAR holds the pointer, the word ends up in SIR
+// Returns false if the pointer is neither memory nor I/O space, the Mima is stopped then.
+static mima_bool mima_indirect_read(mima_t *mima)
+{
+    mima_register address = mima->memory_unit.SAR;
+
+    if (address < mima_words)
+    {
+        mima_cache_hook(mima, address, mima_false);
+        mima->memory_unit.SIR = mima_memory_read(&mima->memory_unit, address);
+        return mima_true;
+    }
+
+    if (address < 0xC000000)
+    {
+        log_warn(" LDIV - pointer 0x%08x is outside of memory, stopping Mima", address);
+        mima_stop_error(mima);
+        return mima_false;
+    }
+
+    mima_word value;
+    mima->control_unit.TRA = mima_false;
+
+    if (mima_io_read(mima, address, &value))
+    {
+        mima->memory_unit.SIR = value;
+        mima->control_unit.TRA = mima_true;
+        return mima_true;
+    }
+
+    log_warn("Reading from undefined I/O space. Nothing will happen!");
+    return mima_true;
+}
+
+// STIV: SAR holds the pointer, SIR the word
+// Returns false if the pointer is neither memory nor I/O space, the Mima is stopped then.
+static mima_bool mima_indirect_write(mima_t *mima)
+{
+    mima_register address = mima->memory_unit.SAR;
+
+    if (address < mima_words)
+    {
+        mima_cache_hook(mima, address, mima_true);
+        mima_memory_write(&mima->memory_unit, address, mima->memory_unit.SIR);
+    }
+    else if (address < 0xC000000)
+    {
+        log_warn(" STIV - pointer 0x%08x is outside of memory, stopping Mima", address);
+        mima_stop_error(mima);
+        return mima_false;
+    }
+    else if (!mima_io_write(mima, address, mima->memory_unit.SIR))
+    {
+        log_warn("Writing into undefined I/O space. Nothing will happen!");
+    }
+
+    return mima_true;
+}
+
+void mima_execute_instruction(mima_t *mima)
+{
+    mima_control_unit *control_unit = &mima->control_unit;
+    mima_memory_unit *memory_unit = &mima->memory_unit;
+    mima_processing_unit *processing_unit = &mima->processing_unit;
+
+    // the micro engine left an instruction behind -> finish it first
+    if (processing_unit->MICRO_CYCLE != 1)
+    {
+        while (processing_unit->MICRO_CYCLE != 1 && control_unit->RUN)
+        {
+            mima_micro_instruction_step(mima);
+        }
+        return;
+    }
+
+    // FETCH: cycles 1 - 5
+    memory_unit->SAR = control_unit->IAR;
+    processing_unit->X = control_unit->IAR;
+    processing_unit->Y = processing_unit->ONE;
+    processing_unit->ALU = ADD;
+    processing_unit->Z = processing_unit->X + processing_unit->Y;
+    control_unit->IAR = processing_unit->Z;
+    mima->current_instruction = mima_instruction_decode(mima);
+    mima_cache_hook(mima, memory_unit->SAR, mima_false);
+    memory_unit->SIR = mima_memory_read(memory_unit, memory_unit->SAR);
+    control_unit->IR = memory_unit->SIR;
+
+    mima_instruction_type op_code = mima->current_instruction.op_code;
+    mima_register address = mima->current_instruction.value;
+
+    // EXECUTE: cycles 6 - 12
+    switch(op_code)
+    {
+    case AND:
+    case OR:
+    case XOR:
+    case ADD:
+    case EQL:
+    case MUL:
+    case SUB:
+        memory_unit->SAR = address;
+        processing_unit->X = processing_unit->ACC;
+        mima_cache_hook(mima, memory_unit->SAR, mima_false);
+        memory_unit->SIR = mima_memory_read(memory_unit, memory_unit->SAR);
+        processing_unit->Y = memory_unit->SIR;
+        processing_unit->ALU = op_code;
+
+        switch(op_code)
+        {
+        case AND:
+            processing_unit->Z = processing_unit->X & processing_unit->Y;
+            break;
+        case OR:
+            processing_unit->Z = processing_unit->X | processing_unit->Y;
+            break;
+        case XOR:
+            processing_unit->Z = processing_unit->X ^ processing_unit->Y;
+            break;
+        case ADD:
+            processing_unit->Z = processing_unit->X + processing_unit->Y;
+            break;
+        case MUL:
+            processing_unit->Z = processing_unit->X * processing_unit->Y;
+            break;
+        case SUB:
+            processing_unit->Z = processing_unit->X - processing_unit->Y;
+            break;
+        default:
+            processing_unit->Z = processing_unit->X == processing_unit->Y ? -1 : 0;
+            break;
+        }
+
+        processing_unit->ACC = processing_unit->Z;
+        log_info("%5s - ACC = 0x%08x", mima_get_instruction_name(op_code), processing_unit->ACC);
+        break;
+    case LDV:
+        memory_unit->SAR = address;
+
+        if (address < 0xC000000)
+        {
+            mima_cache_hook(mima, address, mima_false);
+            memory_unit->SIR = mima_memory_read(memory_unit, address);
+        }
+        else
+        {
+            mima_word value;
+            control_unit->TRA = mima_false;
+
+            if (mima_io_read(mima, address, &value))
+            {
+                memory_unit->SIR = value;
+                control_unit->TRA = mima_true;
+            }
+            else
+            {
+                log_warn("Reading from undefined I/O space. Nothing will happen!");
+            }
+        }
+
+        processing_unit->ACC = memory_unit->SIR;
+        log_info("  LDV - ACC = 0x%08x", processing_unit->ACC);
+        break;
+    case STV:
+        memory_unit->SIR = processing_unit->ACC;
+        memory_unit->SAR = address;
+
+        if (address < 0xC000000)
+        {
+            mima_cache_hook(mima, address, mima_true);
+
+            if (!mima_memory_write(memory_unit, address, memory_unit->SIR))
+            {
+                log_warn("  STV - address 0x%08x is outside of memory, stopping Mima", address);
+                mima_stop_error(mima);
+                break;
+            }
+        }
+        else if (!mima_io_write(mima, address, memory_unit->SIR))
+        {
+            log_warn("Writing into undefined I/O space. Nothing will happen!");
+        }
+
+        log_info("  STV - 0x%08x -> mem[0x%08x]", memory_unit->SIR, address);
+        break;
+    case LDC:
+        processing_unit->ACC = address;
+        log_info("  LDC - ACC = 0x%08x", processing_unit->ACC);
+        break;
+    case HLT:
+        log_info("  HLT - Stopping Mima");
+        control_unit->RUN = mima_false;
+        mima->stop_reason = MIMA_STOP_HALT;
+
+        // HLT ends in micro cycle 6
+        mima->counters.micro_cycles += 6;
+        mima_retire_instruction(mima);
+        return;
+    case JMP:
+        control_unit->IAR = address;
+        log_info("  JMP - to 0x%08x", control_unit->IAR);
+        break;
+    case JMN:
+        if((int32_t)processing_unit->ACC < 0)
+        {
+            control_unit->IAR = address;
+            log_info("  JMN - taken to 0x%08x", address);
+        }
+        else
+        {
+            log_info("  JMN - not taken");
+        }
+        break;
+    case NOT:
+        processing_unit->X = processing_unit->ACC;
+        processing_unit->ALU = NOT;
+        processing_unit->Z = ~processing_unit->X;
+        processing_unit->ACC = processing_unit->Z;
+        log_info("  NOT - ACC = 0x%08x", processing_unit->ACC);
+        break;
+    case RAR:
+        processing_unit->X = processing_unit->ACC;
+        processing_unit->Y = processing_unit->ONE;
+        processing_unit->ALU = RAR;
+        processing_unit->Z = mima_rotate_right(processing_unit->X, processing_unit->Y);
+        processing_unit->ACC = processing_unit->Z;
+        log_info("  RAR - ACC = 0x%08x", processing_unit->ACC);
+        break;
+    case RRN:
+        processing_unit->X = processing_unit->ACC;
+        processing_unit->Y = control_unit->IR & 0x00FFFFFF;
+        processing_unit->ALU = RRN;
+        processing_unit->Z = mima_rotate_right(processing_unit->X, processing_unit->Y);
+        processing_unit->ACC = processing_unit->Z;
+        log_info("  RRN - ACC = 0x%08x", processing_unit->ACC);
+        break;
+    case SHL:
+    case SHR:
+        processing_unit->X = processing_unit->ACC;
+        processing_unit->Y = address;
+        processing_unit->ALU = op_code;
+        processing_unit->Z = mima_shift(op_code, processing_unit->X, processing_unit->Y);
+        processing_unit->ACC = processing_unit->Z;
+        log_info("%5s - ACC = 0x%08x", mima_get_instruction_name(op_code), processing_unit->ACC);
+        break;
+    case LDIV:
+        memory_unit->SAR = address;
+        mima_cache_hook(mima, address, mima_false);
+        memory_unit->SIR = mima_memory_read(memory_unit, address);
+        memory_unit->SAR = memory_unit->SIR & 0x0FFFFFFF;
+
+        if (!mima_indirect_read(mima))
+        {
+            break;
+        }
+
+        processing_unit->ACC = memory_unit->SIR;
+        log_info(" LDIV - ACC = 0x%08x", processing_unit->ACC);
+        break;
+    case STIV:
+        memory_unit->SAR = address;
+        mima_cache_hook(mima, address, mima_false);
+        memory_unit->SIR = mima_memory_read(memory_unit, address);
+        memory_unit->SAR = memory_unit->SIR & 0x0FFFFFFF;
+        memory_unit->SIR = processing_unit->ACC;
+
+        if (!mima_indirect_write(mima))
+        {
+            break;
+        }
+
+        log_info(" STIV - 0x%08x -> mem[0x%08x]", memory_unit->SIR, memory_unit->SAR);
+        break;
+    case CALL:
+        if (control_unit->SP == 0)
+        {
+            log_warn(" CALL - stack overflow, stopping Mima");
+            mima_stop_error(mima);
+            break;
+        }
+
+        processing_unit->X = control_unit->SP;
+        processing_unit->Y = processing_unit->ONE;
+        processing_unit->ALU = SUB;
+        processing_unit->Z = processing_unit->X - processing_unit->Y;
+        control_unit->SP = processing_unit->Z;
+        memory_unit->SAR = processing_unit->Z;
+        memory_unit->SIR = control_unit->IAR;
+        mima_cache_hook(mima, memory_unit->SAR, mima_true);
+        mima_memory_write(memory_unit, memory_unit->SAR, memory_unit->SIR);
+        control_unit->IAR = address;
+        log_info(" CALL - to 0x%08x, return to 0x%08x", control_unit->IAR, memory_unit->SIR);
+        break;
+    case RET:
+        if (control_unit->SP >= mima_words)
+        {
+            log_warn("  RET - the stack is empty, stopping Mima");
+            mima_stop_error(mima);
+            break;
+        }
+
+        memory_unit->SAR = control_unit->SP;
+        mima_cache_hook(mima, memory_unit->SAR, mima_false);
+        memory_unit->SIR = mima_memory_read(memory_unit, memory_unit->SAR);
+        control_unit->IAR = memory_unit->SIR;
+        processing_unit->X = control_unit->SP;
+        processing_unit->Y = processing_unit->ONE;
+        processing_unit->ALU = ADD;
+        processing_unit->Z = processing_unit->X + processing_unit->Y;
+        control_unit->SP = processing_unit->Z;
+        log_info("  RET - to 0x%08x", control_unit->IAR);
+        break;
+    default:
+        log_warn("Invalid instruction - nr.%d - :(\n", op_code);
+        assert(0);
+    }
+
+    mima->counters.micro_cycles += 12;
+    mima_retire_instruction(mima);
+}
+
+uint64_t mima_run_fast(mima_t *mima, uint64_t max_instructions)
+{
+    uint64_t executed = 0;
+
+    while (mima->control_unit.RUN && executed < max_instructions)
+    {
+        mima_execute_instruction(mima);
+        executed++;
+    }
+
+    return executed;
 }
 
 // ADD, AND, OR, XOR, EQL
@@ -248,8 +868,9 @@ void mima_instruction_common(mima_t *mima)
     switch(mima->processing_unit.MICRO_CYCLE)
     {
     case 6:
-        mima->memory_unit.SAR = mima->control_unit.IR & 0x0FFFFFFF;
-        log_trace("%5s - %02d: IR & 0x0FFFFFFF -> SAR \t 0x%08x -> SAR \t\t I/O Read disposed", mima_get_instruction_name(mima->current_instruction.op_code), mima->processing_unit.MICRO_CYCLE, mima->control_unit.IR & 0x0FFFFFFF);
+        // MUL and SUB are extended instructions with a 24 bit address
+        mima->memory_unit.SAR = mima->current_instruction.value;
+        log_trace("%5s - %02d: IR & 0x%s -> SAR \t 0x%08x -> SAR \t\t I/O Read disposed", mima_get_instruction_name(mima->current_instruction.op_code), mima->processing_unit.MICRO_CYCLE, mima->current_instruction.extended ? "00FFFFFF" : "0FFFFFFF", mima->current_instruction.value);
         break;
     case 7:
         mima->processing_unit.X = mima->processing_unit.ACC;
@@ -259,7 +880,8 @@ void mima_instruction_common(mima_t *mima)
         log_trace("%5s - %02d: empty \t\t\t\t\t\t\t I/O waiting...", mima_get_instruction_name(mima->current_instruction.op_code), mima->processing_unit.MICRO_CYCLE);
         break;
     case 9:
-        mima->memory_unit.SIR = mima->memory_unit.memory[mima->memory_unit.SAR];
+        mima_cache_hook(mima, mima->memory_unit.SAR, mima_false);
+        mima->memory_unit.SIR = mima_memory_read(&mima->memory_unit, mima->memory_unit.SAR);
         log_trace("%5s - %02d: mem[SAR] -> SIR \t\t mem[0x%08x] -> SIR \t I/O Read done", mima_get_instruction_name(mima->current_instruction.op_code), mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
         break;
     case 10:
@@ -292,6 +914,14 @@ void mima_instruction_common(mima_t *mima)
             mima->processing_unit.Z = mima->processing_unit.X == mima->processing_unit.Y ? -1 : 0;
             log_trace("%5s - %02d: X == Y ? -1 : 0 -> Z \t 0x%08x == 0x%08x ? -1 : 0 -> Z", mima_get_instruction_name(mima->current_instruction.op_code), mima->processing_unit.MICRO_CYCLE, mima->processing_unit.X, mima->processing_unit.Y);
             break;
+        case MUL:
+            mima->processing_unit.Z = mima->processing_unit.X * mima->processing_unit.Y;
+            log_trace("%5s - %02d: X * Y -> Z \t\t\t 0x%08x * 0x%08x -> Z", mima_get_instruction_name(mima->current_instruction.op_code), mima->processing_unit.MICRO_CYCLE, mima->processing_unit.X, mima->processing_unit.Y);
+            break;
+        case SUB:
+            mima->processing_unit.Z = mima->processing_unit.X - mima->processing_unit.Y;
+            log_trace("%5s - %02d: X - Y -> Z \t\t\t 0x%08x - 0x%08x -> Z", mima_get_instruction_name(mima->current_instruction.op_code), mima->processing_unit.MICRO_CYCLE, mima->processing_unit.X, mima->processing_unit.Y);
+            break;
         default:
             break;
         }
@@ -317,10 +947,10 @@ void mima_instruction_LDV(mima_t *mima)
         log_trace("  LDV - %02d: IR & 0x0FFFFFFF -> SAR \t 0x%08x -> SAR \t\t I/O Read disposed", mima->processing_unit.MICRO_CYCLE, mima->control_unit.IR & 0x0FFFFFFF);
         break;
     case 7:
-        log_trace("  LDV - %02d: empty \t\t\t\t\t\t\t I/O waiting...");
+        log_trace("  LDV - %02d: empty \t\t\t\t\t\t\t I/O waiting...", mima->processing_unit.MICRO_CYCLE);
         break;
     case 8:
-        log_trace("  LDV - %02d: empty \t\t\t\t\t\t\t I/O waiting...");
+        log_trace("  LDV - %02d: empty \t\t\t\t\t\t\t I/O waiting...", mima->processing_unit.MICRO_CYCLE);
         break;
     case 9:
     {
@@ -329,7 +959,8 @@ void mima_instruction_LDV(mima_t *mima)
         if (address < 0xC000000)
         {
             // internal memory
-            mima->memory_unit.SIR = mima->memory_unit.memory[mima->memory_unit.SAR];
+            mima_cache_hook(mima, mima->memory_unit.SAR, mima_false);
+            mima->memory_unit.SIR = mima_memory_read(&mima->memory_unit, mima->memory_unit.SAR);
             log_trace("  LDV - %02d: mem[SAR] -> SIR \t\t mem[0x%08x] -> SIR \t I/O Read done", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
         }
         else
@@ -337,31 +968,16 @@ void mima_instruction_LDV(mima_t *mima)
             mima->control_unit.TRA = mima_false;
 
             // I/O space
-            if (address == mima_char_input)
+            mima_word value;
+            if (mima_io_read(mima, address, &value))
             {
-                printf("Waiting for single char:");
-                char res = getchar();
-                mima->memory_unit.SIR = res;
-                log_trace("  LDV - %02d: Char -> SIR \t\t '%c' -> SIR \t I/O Read done", mima->processing_unit.MICRO_CYCLE, res);
-                mima->control_unit.TRA = mima_true;
-                break;
-            }
-
-            if (address == mima_integer_input)
-            {
-                printf("Waiting for number (dec or hex [with 0x-prefix]):");
-                char number_string[32] = {0};
-                char* endptr;
-                fgets(number_string, 31, stdin);
-                int number = strtol(number_string, &endptr, 0);
-                mima->memory_unit.SIR = number;
-                log_trace("  LDV - %02d: Integer -> SIR \t\t %d aka 0x%08x -> SIR \t I/O Read done", mima->processing_unit.MICRO_CYCLE, number, number);
+                mima->memory_unit.SIR = value;
+                log_trace("  LDV - %02d: I/O -> SIR \t\t %d aka 0x%08x -> SIR \t I/O Read done", mima->processing_unit.MICRO_CYCLE, value, value);
                 mima->control_unit.TRA = mima_true;
                 break;
             }
 
-
-            log_warn("Writing into undefined I/O space. Nothing will happen!");
+            log_warn("Reading from undefined I/O space. Nothing will happen!");
 
         }
         break;
@@ -371,11 +987,11 @@ void mima_instruction_LDV(mima_t *mima)
         log_trace("  LDV - %02d: SIR -> ACC \t\t\t 0x%08x -> ACC", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SIR);
         break;
     case 11:
-        log_trace("  LDV - %02d: empty");
+        log_trace("  LDV - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 12:
-        log_trace("  LDV - %02d: empty");
-        log_info("  LDV - ACC = 0x%08x", mima_get_instruction_name(mima->current_instruction.op_code), mima->processing_unit.ACC);
+        log_trace("  LDV - %02d: empty", mima->processing_unit.MICRO_CYCLE);
+        log_info("  LDV - ACC = 0x%08x", mima->processing_unit.ACC);
         break;
     default:
         log_warn("Invalid micro cycle. Must be between 6-12, was %d :(\n", mima->processing_unit.MICRO_CYCLE);
@@ -408,22 +1024,23 @@ void mima_instruction_STV(mima_t *mima)
         // writing to "internal" memory
         if (address < 0xc000000)
         {
-            mima->memory_unit.memory[address] = mima->memory_unit.SIR;
+            mima_cache_hook(mima, address, mima_true);
+
+            if (!mima_memory_write(&mima->memory_unit, address, mima->memory_unit.SIR))
+            {
+                log_warn("  STV - address 0x%08x is outside of memory, stopping Mima", address);
+                mima_stop_error(mima);
+                mima->processing_unit.MICRO_CYCLE = 0;
+                break;
+            }
+
             log_trace("  STV - %02d: SIR -> mem[IR & 0x0FFFFFFF] \t 0x%08x -> mem[0x%08x] \t I/O Write done", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SIR, address);
             break;
         }
         else
         {
-            // writing to IO -> ignoring the  first 4 bits
-            if (address == mima_char_output)
-            {
-                printf("%c\n", mima->memory_unit.SIR & 0x0FFFFFFF);
-                break;
-            }
-
-            if (address == mima_integer_output)
+            if (mima_io_write(mima, address, mima->memory_unit.SIR))
             {
-                printf("%d\n", mima->memory_unit.SIR & 0x0FFFFFFF);
                 break;
             }
 
@@ -451,6 +1068,7 @@ void mima_instruction_HLT(mima_t *mima)
     log_trace("  HLT - %02d: Setting RUN to false", mima->processing_unit.MICRO_CYCLE);
     log_info("  HLT - Stopping Mima");
     mima->control_unit.RUN = mima_false;
+    mima->stop_reason = MIMA_STOP_HALT;
     mima->processing_unit.MICRO_CYCLE = 0;
 }
 
@@ -463,22 +1081,22 @@ void mima_instruction_LDC(mima_t *mima)
         log_trace("  LDC - %02d: IR & 0x0FFFFFFF -> ACC \t 0x%08x -> ACC", mima->processing_unit.MICRO_CYCLE, mima->control_unit.IR & 0x0FFFFFFF);
         break;
     case 7:
-        log_trace("  LDC - %02d: empty");
+        log_trace("  LDC - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 8:
-        log_trace("  LDC - %02d: empty");
+        log_trace("  LDC - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 9:
-        log_trace("  LDC - %02d: empty");
+        log_trace("  LDC - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 10:
-        log_trace("  LDC - %02d: empty");
+        log_trace("  LDC - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 11:
-        log_trace("  LDC - %02d: empty");
+        log_trace("  LDC - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 12:
-        log_trace("  LDC - %02d: empty");
+        log_trace("  LDC - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         log_info("  LDC - ACC = 0x%08x", mima->processing_unit.ACC);
         break;
     default:
@@ -496,22 +1114,22 @@ void mima_instruction_JMP(mima_t *mima)
         log_trace("  JMP - %02d: IR & 0x0FFFFFFF -> JMP \t", mima->processing_unit.MICRO_CYCLE);
         break;
     case 7:
-        log_trace("  JMP - %02d: empty");
+        log_trace("  JMP - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 8:
-        log_trace("  JMP - %02d: empty");
+        log_trace("  JMP - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 9:
-        log_trace("  JMP - %02d: empty");
+        log_trace("  JMP - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 10:
-        log_trace("  JMP - %02d: empty");
+        log_trace("  JMP - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 11:
-        log_trace("  JMP - %02d: empty");
+        log_trace("  JMP - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 12:
-        log_trace("  JMP - %02d: empty");
+        log_trace("  JMP - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         log_info("  JMP - to 0x%08x", mima->control_unit.IAR);
         break;
     default:
@@ -532,26 +1150,26 @@ void mima_instruction_JMN(mima_t *mima)
         }
         else
         {
-            log_trace("  JMN - %02d: ACC = 0x%08x - No jump taken", mima->processing_unit.MICRO_CYCLE, mima->processing_unit.ACC, mima->control_unit.IR & 0x0FFFFFFF);
+            log_trace("  JMN - %02d: ACC = 0x%08x - No jump taken", mima->processing_unit.MICRO_CYCLE, mima->processing_unit.ACC);
         }
         break;
     case 7:
-        log_trace("  JMN - %02d: empty");
+        log_trace("  JMN - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 8:
-        log_trace("  JMN - %02d: empty");
+        log_trace("  JMN - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 9:
-        log_trace("  JMN - %02d: empty");
+        log_trace("  JMN - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 10:
-        log_trace("  JMN - %02d: empty");
+        log_trace("  JMN - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 11:
-        log_trace("  JMN - %02d: empty");
+        log_trace("  JMN - %02d: empty", mima->processing_unit.MICRO_CYCLE);
         break;
     case 12:
-        log_trace("  JMN - %02d: empty");
+        log_trace("  JMN - %02d: empty", mima->processing_unit.MICRO_CYCLE);
 
         if((int32_t)mima->processing_unit.ACC < 0)
         {
@@ -690,6 +1308,223 @@ void mima_instruction_RRN(mima_t *mima)
     }
 }
 
+void mima_instruction_SHIFT(mima_t *mima)
+{
+    const char *name = mima_get_instruction_name(mima->current_instruction.op_code);
+
+    switch(mima->processing_unit.MICRO_CYCLE)
+    {
+    case 7:
+        mima->processing_unit.X = mima->processing_unit.ACC;
+        log_trace("%5s - %02d: ACC -> X \t\t\t 0x%08x -> X", name, mima->processing_unit.MICRO_CYCLE, mima->processing_unit.ACC);
+        break;
+    case 10:
+        mima->processing_unit.Y = mima->control_unit.IR & 0x00FFFFFF;
+        log_trace("%5s - %02d: IR & 0x00FFFFFF -> Y \t 0x%08x -> Y", name, mima->processing_unit.MICRO_CYCLE, mima->control_unit.IR & 0x00FFFFFF);
+        mima->processing_unit.ALU = mima->current_instruction.op_code;
+        log_trace("%5s - %02d: Set ALU to %s", name, mima->processing_unit.MICRO_CYCLE, name);
+        break;
+    case 11:
+        mima->processing_unit.Z = mima_shift(mima->current_instruction.op_code, mima->processing_unit.X, mima->processing_unit.Y);
+        log_trace("%5s - %02d: X %s Y -> Z \t\t\t 0x%08x -> Z", name, mima->processing_unit.MICRO_CYCLE, mima->current_instruction.op_code == SHL ? "<<" : ">>>", mima->processing_unit.Z);
+        break;
+    case 12:
+        mima->processing_unit.ACC = mima->processing_unit.Z;
+        log_trace("%5s - %02d: Z -> ACC \t\t\t 0x%08x -> ACC", name, mima->processing_unit.MICRO_CYCLE, mima->processing_unit.Z);
+        log_info("%5s - ACC = 0x%08x", name, mima->processing_unit.ACC);
+        break;
+    case 6:
+    case 8:
+    case 9:
+        log_trace("%5s - %02d: empty", name, mima->processing_unit.MICRO_CYCLE);
+        break;
+    default:
+        log_warn("Invalid micro cycle. Must be between 6-12, was %d :(\n", mima->processing_unit.MICRO_CYCLE);
+        assert(0);
+    }
+}
+
+void mima_instruction_LDIV(mima_t *mima)
+{
+    switch(mima->processing_unit.MICRO_CYCLE)
+    {
+    case 6:
+        mima->memory_unit.SAR = mima->control_unit.IR & 0x00FFFFFF;
+        log_trace(" LDIV - %02d: IR & 0x00FFFFFF -> SAR \t 0x%08x -> SAR \t\t I/O Read disposed", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
+        break;
+    case 9:
+        mima_cache_hook(mima, mima->memory_unit.SAR, mima_false);
+        mima->memory_unit.SIR = mima_memory_read(&mima->memory_unit, mima->memory_unit.SAR);
+        log_trace(" LDIV - %02d: mem[SAR] -> SIR \t\t mem[0x%08x] -> SIR \t I/O Read done", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
+        break;
+    case 10:
+        mima->memory_unit.SAR = mima->memory_unit.SIR & 0x0FFFFFFF;
+        log_trace(" LDIV - %02d: SIR & 0x0FFFFFFF -> SAR \t 0x%08x -> SAR \t\t I/O Read disposed", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
+        break;
+    case 11:
+        if (!mima_indirect_read(mima))
+        {
+            mima->processing_unit.MICRO_CYCLE = 0;
+            break;
+        }
+
+        log_trace(" LDIV - %02d: mem[SAR] -> SIR \t\t mem[0x%08x] -> SIR \t I/O Read done", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
+        break;
+    case 12:
+        mima->processing_unit.ACC = mima->memory_unit.SIR;
+        log_trace(" LDIV - %02d: SIR -> ACC \t\t\t 0x%08x -> ACC", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SIR);
+        log_info(" LDIV - ACC = 0x%08x", mima->processing_unit.ACC);
+        break;
+    case 7:
+    case 8:
+        log_trace(" LDIV - %02d: empty \t\t\t\t\t\t\t I/O waiting...", mima->processing_unit.MICRO_CYCLE);
+        break;
+    default:
+        log_warn("Invalid micro cycle. Must be between 6-12, was %d :(\n", mima->processing_unit.MICRO_CYCLE);
+        assert(0);
+    }
+}
+
+void mima_instruction_STIV(mima_t *mima)
+{
+    switch(mima->processing_unit.MICRO_CYCLE)
+    {
+    case 6:
+        mima->memory_unit.SAR = mima->control_unit.IR & 0x00FFFFFF;
+        log_trace(" STIV - %02d: IR & 0x00FFFFFF -> SAR \t 0x%08x -> SAR \t\t I/O Read disposed", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
+        break;
+    case 9:
+        mima_cache_hook(mima, mima->memory_unit.SAR, mima_false);
+        mima->memory_unit.SIR = mima_memory_read(&mima->memory_unit, mima->memory_unit.SAR);
+        log_trace(" STIV - %02d: mem[SAR] -> SIR \t\t mem[0x%08x] -> SIR \t I/O Read done", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
+        break;
+    case 10:
+        mima->memory_unit.SAR = mima->memory_unit.SIR & 0x0FFFFFFF;
+        log_trace(" STIV - %02d: SIR & 0x0FFFFFFF -> SAR \t 0x%08x -> SAR \t\t I/O Write disposed", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
+        break;
+    case 11:
+        mima->memory_unit.SIR = mima->processing_unit.ACC;
+        log_trace(" STIV - %02d: ACC -> SIR \t\t\t 0x%08x -> SIR", mima->processing_unit.MICRO_CYCLE, mima->processing_unit.ACC);
+        break;
+    case 12:
+        if (!mima_indirect_write(mima))
+        {
+            mima->processing_unit.MICRO_CYCLE = 0;
+            break;
+        }
+
+        log_trace(" STIV - %02d: SIR -> mem[SAR] \t\t 0x%08x -> mem[0x%08x] \t I/O Write done", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SIR, mima->memory_unit.SAR);
+        log_info(" STIV - 0x%08x -> mem[0x%08x]", mima->memory_unit.SIR, mima->memory_unit.SAR);
+        break;
+    case 7:
+    case 8:
+        log_trace(" STIV - %02d: empty \t\t\t\t\t\t\t I/O waiting...", mima->processing_unit.MICRO_CYCLE);
+        break;
+    default:
+        log_warn("Invalid micro cycle. Must be between 6-12, was %d :(\n", mima->processing_unit.MICRO_CYCLE);
+        assert(0);
+    }
+}
+
+void mima_instruction_CALL(mima_t *mima)
+{
+    switch(mima->processing_unit.MICRO_CYCLE)
+    {
+    case 6:
+        if (mima->control_unit.SP == 0)
+        {
+            log_warn(" CALL - stack overflow, stopping Mima");
+            mima_stop_error(mima);
+            mima->processing_unit.MICRO_CYCLE = 0;
+            break;
+        }
+
+        mima->processing_unit.X = mima->control_unit.SP;
+        log_trace(" CALL - %02d: SP -> X \t\t\t 0x%08x -> X", mima->processing_unit.MICRO_CYCLE, mima->control_unit.SP);
+        mima->processing_unit.Y = mima->processing_unit.ONE;
+        log_trace(" CALL - %02d: ONE -> Y", mima->processing_unit.MICRO_CYCLE);
+        mima->processing_unit.ALU = SUB;
+        log_trace(" CALL - %02d: Set ALU to SUB", mima->processing_unit.MICRO_CYCLE);
+        break;
+    case 7:
+        mima->processing_unit.Z = mima->processing_unit.X - mima->processing_unit.Y;
+        log_trace(" CALL - %02d: X - Y -> Z \t\t\t 0x%08x - 0x%08x -> Z", mima->processing_unit.MICRO_CYCLE, mima->processing_unit.X, mima->processing_unit.Y);
+        break;
+    case 8:
+        mima->control_unit.SP = mima->processing_unit.Z;
+        mima->memory_unit.SAR = mima->processing_unit.Z;
+        log_trace(" CALL - %02d: Z -> SP, Z -> SAR \t\t 0x%08x -> SP \t\t I/O Write disposed", mima->processing_unit.MICRO_CYCLE, mima->processing_unit.Z);
+        break;
+    case 9:
+        mima->memory_unit.SIR = mima->control_unit.IAR;
+        log_trace(" CALL - %02d: IAR -> SIR \t\t\t 0x%08x -> SIR", mima->processing_unit.MICRO_CYCLE, mima->control_unit.IAR);
+        break;
+    case 10:
+        mima_cache_hook(mima, mima->memory_unit.SAR, mima_true);
+        mima_memory_write(&mima->memory_unit, mima->memory_unit.SAR, mima->memory_unit.SIR);
+        log_trace(" CALL - %02d: SIR -> mem[SAR] \t\t 0x%08x -> mem[0x%08x] \t I/O Write done", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SIR, mima->memory_unit.SAR);
+        break;
+    case 11:
+        mima->control_unit.IAR = mima->control_unit.IR & 0x00FFFFFF;
+        log_trace(" CALL - %02d: IR & 0x00FFFFFF -> IAR \t 0x%08x -> IAR", mima->processing_unit.MICRO_CYCLE, mima->control_unit.IAR);
+        break;
+    case 12:
+        log_trace(" CALL - %02d: empty", mima->processing_unit.MICRO_CYCLE);
+        log_info(" CALL - to 0x%08x, return to 0x%08x", mima->control_unit.IAR, mima->memory_unit.SIR);
+        break;
+    default:
+        log_warn("Invalid micro cycle. Must be between 6-12, was %d :(\n", mima->processing_unit.MICRO_CYCLE);
+        assert(0);
+    }
+}
+
+void mima_instruction_RET(mima_t *mima)
+{
+    switch(mima->processing_unit.MICRO_CYCLE)
+    {
+    case 6:
+        if (mima->control_unit.SP >= mima_words)
+        {
+            log_warn("  RET - the stack is empty, stopping Mima");
+            mima_stop_error(mima);
+            mima->processing_unit.MICRO_CYCLE = 0;
+            break;
+        }
+
+        mima->memory_unit.SAR = mima->control_unit.SP;
+        log_trace("  RET - %02d: SP -> SAR \t\t\t 0x%08x -> SAR \t\t I/O Read disposed", mima->processing_unit.MICRO_CYCLE, mima->control_unit.SP);
+        break;
+    case 9:
+        mima_cache_hook(mima, mima->memory_unit.SAR, mima_false);
+        mima->memory_unit.SIR = mima_memory_read(&mima->memory_unit, mima->memory_unit.SAR);
+        log_trace("  RET - %02d: mem[SAR] -> SIR \t\t mem[0x%08x] -> SIR \t I/O Read done", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SAR);
+        break;
+    case 10:
+        mima->control_unit.IAR = mima->memory_unit.SIR;
+        log_trace("  RET - %02d: SIR -> IAR \t\t\t 0x%08x -> IAR", mima->processing_unit.MICRO_CYCLE, mima->memory_unit.SIR);
+        break;
+    case 11:
+        mima->processing_unit.X = mima->control_unit.SP;
+        mima->processing_unit.Y = mima->processing_unit.ONE;
+        mima->processing_unit.ALU = ADD;
+        mima->processing_unit.Z = mima->processing_unit.X + mima->processing_unit.Y;
+        log_trace("  RET - %02d: SP + ONE -> Z \t\t 0x%08x -> Z", mima->processing_unit.MICRO_CYCLE, mima->processing_unit.Z);
+        break;
+    case 12:
+        mima->control_unit.SP = mima->processing_unit.Z;
+        log_trace("  RET - %02d: Z -> SP \t\t\t 0x%08x -> SP", mima->processing_unit.MICRO_CYCLE, mima->processing_unit.Z);
+        log_info("  RET - to 0x%08x", mima->control_unit.IAR);
+        break;
+    case 7:
+    case 8:
+        log_trace("  RET - %02d: empty \t\t\t\t\t\t\t I/O waiting...", mima->processing_unit.MICRO_CYCLE);
+        break;
+    default:
+        log_warn("Invalid micro cycle. Must be between 6-12, was %d :(\n", mima->processing_unit.MICRO_CYCLE);
+        assert(0);
+    }
+}
+
 void mima_print_memory_at(mima_t *mima, mima_register address, uint32_t count)
 {
     if (address < 0 || address > mima_words - 1)
@@ -698,10 +1533,7 @@ void mima_print_memory_at(mima_t *mima, mima_register address, uint32_t count)
         return;
     }
 
-    for (int i = 0; address + i < mima_words - 1 && i < count; ++i)
-    {
-        printf("mem[0x%08x] = 0x%08x\n", address + i, mima->memory_unit.memory[address + i]);
-    }
+    mima_disassembler_print(&mima->memory_unit, stdout, address, count);
 }
 
 void mima_print_memory_unit_state(mima_t *mima)
@@ -720,8 +1552,10 @@ void mima_print_control_unit_state(mima_t *mima)
     printf(" IR \t    = 0x%08x\n", mima->control_unit.IR);
     printf(" IAR\t    = 0x%08x\n", mima->control_unit.IAR);
     printf(" IP \t    = 0x%08x\n", mima->control_unit.IP);
+    printf(" SP \t    = 0x%08x\n", mima->control_unit.SP);
     printf(" TRA\t    = %s\n", mima->control_unit.TRA ? "true" : "false");
     printf(" RUN\t    = %s\n", mima->control_unit.RUN ? "true" : "false");
+    printf(" STOP\t    = %s\n", mima_stop_reason_name(mima->stop_reason));
     printf("=========================\n");
 }
 
@@ -738,11 +1572,27 @@ void mima_print_processing_unit_state(mima_t *mima)
     printf("=========================\n");
 }
 
+void mima_print_counters(mima_t *mima)
+{
+    printf("\n");
+    printf("=======COUNTERS==========\n");
+    printf(" INSTR\t    = %llu\n", (unsigned long long)mima->counters.instructions);
+    printf(" MICRO\t    = %llu\n", (unsigned long long)mima->counters.micro_cycles);
+    printf(" CYCLES\t    = %llu\n", (unsigned long long)mima->counters.cycles);
+
+    if (mima->dma.enabled)
+    {
+        printf(" DMA\t    = %llu transfers, %llu words\n", (unsigned long long)mima->dma.transfers, (unsigned long long)mima->dma.words);
+    }
+    printf("=========================\n");
+}
+
 void mima_print_state(mima_t *mima)
 {
     mima_print_processing_unit_state(mima);
     mima_print_control_unit_state(mima);
     mima_print_memory_unit_state(mima);
+    mima_print_counters(mima);
 }
 
 const char *mima_get_instruction_name(mima_instruction_type op_code)
@@ -777,14 +1627,38 @@ const char *mima_get_instruction_name(mima_instruction_type op_code)
         return "RAR";
     case RRN:
         return "RRN";
+    case MUL:
+        return "MUL";
+    case SUB:
+        return "SUB";
+    case SHL:
+        return "SHL";
+    case SHR:
+        return "SHR";
+    case LDIV:
+        return "LDIV";
+    case STIV:
+        return "STIV";
+    case CALL:
+        return "CALL";
+    case RET:
+        return "RET";
     }
     return "INVALID";
 }
 
 void mima_delete(mima_t *mima)
 {
-    free(mima->memory_unit.memory);
+    mima_checkpoint_delete(mima->checkpoint, mima);
+    mima_telemetry_delete(mima->telemetry, mima);
+    mima_interrupts_delete(mima);
+    mima_memory_delete(&mima->memory_unit);
+    mima_pipeline_delete(mima->pipeline);
+    mima_cache_delete(mima->cache);
+    mima_predictor_delete(mima->predictor);
+    mima_io_log_close(mima->io_log);
     free(mima_labels);
+    mima_image_free(&mima_assembled_image);
 }
 
 
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mima_analysis.h"
+#include "mima_compiler.h"
+#include "log.h"
+
+typedef struct _mima_cfg
+{
+    const mima_image_entry	*code;			// the first instructions_count image entries
+    uint32_t				count;
+    uint32_t				*returns;		// addresses after every CALL, successors of RET
+    uint32_t				returns_count;
+} mima_cfg;
+
+// the result of a jump or fall through outside of the code
+typedef enum _mima_cfg_target
+{
+    MIMA_TARGET_CODE = 0,
+    MIMA_TARGET_DATA,
+    MIMA_TARGET_UNINITIALIZED,
+    MIMA_TARGET_IO
+} mima_cfg_target;
+
+static mima_instruction mima_cfg_decode(mima_word word)
+{
+    mima_instruction instruction;
+
+    if (word >> 28 != 0xF)
+    {
+        instruction.op_code = word >> 28;
+        instruction.value = word & 0x0FFFFFFF;
+        instruction.extended = mima_false;
+    }
+    else
+    {
+        instruction.op_code = word >> 24;
+        instruction.value = word & 0x00FFFFFF;
+        instruction.extended = mima_true;
+    }
+
+    return instruction;
+}
+
+static int mima_cfg_compare_entry(const void *key, const void *element)
+{
+    mima_register address = *(const mima_register *)key;
+    const mima_image_entry *entry = element;
+
+    return (address > entry->address) - (address < entry->address);
+}
+
+static mima_cfg_target mima_cfg_classify(const mima_cfg *cfg, mima_register address)
+{
+    if (address < cfg->count)
+    {
+        return MIMA_TARGET_CODE;
+    }
+
+    if (address >= 0xC000000)
+    {
+        return MIMA_TARGET_IO;
+    }
+
+    if (bsearch(&address, mima_assembled_image.entries, mima_assembled_image.count, sizeof(mima_image_entry), mima_cfg_compare_entry))
+    {
+        return MIMA_TARGET_DATA;
+    }
+
+    return MIMA_TARGET_UNINITIALIZED;
+}
+
+// k-th successor of the instruction at address, UINT32_MAX when there are no more
+static uint32_t mima_cfg_successor(const mima_cfg *cfg, uint32_t address, uint32_t k)
+{
+    mima_instruction instruction = mima_cfg_decode(cfg->code[address].word);
+
+    switch (instruction.op_code)
+    {
+    case HLT:
+        return UINT32_MAX;
+    case JMP:
+        return k == 0 ? instruction.value : UINT32_MAX;
+    case JMN:
+    case CALL:
+        return k == 0 ? address + 1 : k == 1 ? instruction.value : UINT32_MAX;
+    case RET:
+        return k < cfg->returns_count ? cfg->returns[k] : UINT32_MAX;
+    default:
+        return k == 0 ? address + 1 : UINT32_MAX;
+    }
+}
+
+// I/O keeps a loop alive: it may wait for the user or be stopped from outside
+static mima_bool mima_cfg_does_io(const mima_cfg *cfg, uint32_t address)
+{
+    mima_instruction instruction = mima_cfg_decode(cfg->code[address].word);
+
+    switch (instruction.op_code)
+    {
+    case LDV:
+    case STV:
+        return instruction.value >= 0xC000000;
+    case LDIV:
+    case STIV:
+        // the pointer is only known at run time
+        return mima_true;
+    default:
+        return mima_false;
+    }
+}
+
+static const char *mima_cfg_target_names[] = { "code", "data", "uninitialized memory", "the I/O space" };
+
+// Tarjan without recursion, reports strongly connected components that can never be left.
+static void mima_cfg_find_dead_loops(const mima_cfg *cfg, const uint8_t *reachable, mima_analysis_result *result)
+{
+    uint32_t n = cfg->count;
+    uint32_t *index = malloc(n * sizeof(uint32_t));
+    uint32_t *low = malloc(n * sizeof(uint32_t));
+    uint32_t *stack = malloc(n * sizeof(uint32_t));
+    uint32_t *call_node = malloc(n * sizeof(uint32_t));
+    uint32_t *call_edge = malloc(n * sizeof(uint32_t));
+    uint8_t *on_stack = calloc(n, 1);
+
+    if (!index || !low || !stack || !call_node || !call_edge || !on_stack)
+    {
+        log_fatal("Could not allocate memory for the control flow analysis :(");
+        assert(0);
+    }
+
+    memset(index, 0xFF, n * sizeof(uint32_t));
+
+    uint32_t next_index = 0;
+    uint32_t stack_count = 0;
+
+    for (uint32_t root = 0; root < n; ++root)
+    {
+        if (!reachable[root] || index[root] != UINT32_MAX)
+        {
+            continue;
+        }
+
+        uint32_t depth = 0;
+        call_node[0] = root;
+        call_edge[0] = 0;
+        index[root] = low[root] = next_index++;
+        stack[stack_count++] = root;
+        on_stack[root] = 1;
+
+        while (1)
+        {
+            uint32_t node = call_node[depth];
+            uint32_t successor = mima_cfg_successor(cfg, node, call_edge[depth]);
+
+            if (successor != UINT32_MAX)
+            {
+                call_edge[depth]++;
+
+                if (successor >= n)
+                {
+                    continue;
+                }
+
+                if (index[successor] == UINT32_MAX)
+                {
+                    index[successor] = low[successor] = next_index++;
+                    stack[stack_count++] = successor;
+                    on_stack[successor] = 1;
+                    depth++;
+                    call_node[depth] = successor;
+                    call_edge[depth] = 0;
+                }
+                else if (on_stack[successor] && index[successor] < low[node])
+                {
+                    low[node] = index[successor];
+                }
+
+                continue;
+            }
+
+            // all successors done -> node may be the root of a component
+            if (low[node] == index[node])
+            {
+                uint32_t first = stack_count;
+
+                do
+                {
+                    first--;
+                }
+                while (stack[first] != node);
+
+                mima_bool cyclic = stack_count - first > 1;
+                mima_bool exits = mima_false;
+                mima_bool io = mima_false;
+                uint32_t lowest = node;
+
+                for (uint32_t i = first; i < stack_count; ++i)
+                {
+                    uint32_t member = stack[i];
+                    uint32_t successor_of_member;
+
+                    for (uint32_t k = 0; (successor_of_member = mima_cfg_successor(cfg, member, k)) != UINT32_MAX; ++k)
+                    {
+                        cyclic |= successor_of_member == member;
+
+                        // leaving the component, also to memory outside the code (reported elsewhere)
+                        if (successor_of_member >= n || !on_stack[successor_of_member] || index[successor_of_member] < index[node])
+                        {
+                            exits = mima_true;
+                        }
+                    }
+
+                    exits |= mima_cfg_decode(cfg->code[member].word).op_code == HLT;
+                    io |= mima_cfg_does_io(cfg, member);
+                    lowest = member < lowest ? member : lowest;
+                }
+
+                if (cyclic && !exits && !io)
+                {
+                    log_error("%s: the loop at 0x%08x never halts and does no I/O.", mima_source_location(cfg->code[lowest].file, cfg->code[lowest].line), lowest);
+                    result->errors++;
+                }
+
+                for (uint32_t i = first; i < stack_count; ++i)
+                {
+                    on_stack[stack[i]] = 0;
+                }
+
+                stack_count = first;
+            }
+
+            if (depth == 0)
+            {
+                break;
+            }
+
+            depth--;
+
+            uint32_t parent = call_node[depth];
+            low[parent] = low[node] < low[parent] ? low[node] : low[parent];
+        }
+    }
+
+    free(index);
+    free(low);
+    free(stack);
+    free(call_node);
+    free(call_edge);
+    free(on_stack);
+}
+
+mima_analysis_result mima_analyze_image()
+{
+    mima_analysis_result result = { 0, 0 };
+    mima_cfg cfg = { 0 };
+
+    cfg.code = mima_assembled_image.entries;
+    cfg.count = mima_assembled_image.instructions_count;
+
+    // code is assembled without gaps, so the first entries are the addresses 0 - count-1
+    if (cfg.count == 0 || mima_assembled_image.count < cfg.count || cfg.code[cfg.count - 1].address != cfg.count - 1)
+    {
+        log_error("There is no code to analyze.");
+        result.errors++;
+        return result;
+    }
+
+    cfg.returns = malloc(cfg.count * sizeof(uint32_t));
+    uint32_t *worklist = malloc(cfg.count * sizeof(uint32_t));
+    uint8_t *reachable = calloc(cfg.count, 1);
+
+    if (!cfg.returns || !worklist || !reachable)
+    {
+        log_fatal("Could not allocate memory for the control flow analysis :(");
+        assert(0);
+    }
+
+    for (uint32_t address = 0; address < cfg.count; ++address)
+    {
+        mima_instruction instruction = mima_cfg_decode(cfg.code[address].word);
+
+        if (instruction.op_code == CALL)
+        {
+            cfg.returns[cfg.returns_count++] = address + 1;
+        }
+
+        if (instruction.op_code == STV && instruction.value < cfg.count)
+        {
+            log_warn("%s: STV at 0x%08x writes into code, the analysis can not follow self modifying code.", mima_source_location(cfg.code[address].file, cfg.code[address].line), address);
+            result.warnings++;
+        }
+    }
+
+    // reachability from the entry point
+    uint32_t worklist_count = 0;
+    mima_bool halts = mima_false;
+    worklist[worklist_count++] = 0;
+    reachable[0] = 1;
+
+    while (worklist_count > 0)
+    {
+        uint32_t address = worklist[--worklist_count];
+        uint32_t successor;
+        mima_instruction_type op_code = mima_cfg_decode(cfg.code[address].word).op_code;
+
+        halts |= op_code == HLT;
+
+        for (uint32_t k = 0; (successor = mima_cfg_successor(&cfg, address, k)) != UINT32_MAX; ++k)
+        {
+            mima_cfg_target target = mima_cfg_classify(&cfg, successor);
+
+            if (target == MIMA_TARGET_CODE)
+            {
+                if (!reachable[successor])
+                {
+                    reachable[successor] = 1;
+                    worklist[worklist_count++] = successor;
+                }
+
+                continue;
+            }
+
+            // the first successor of everything but JMP and RET is the next word
+            const char *how = k == 0 && op_code != JMP && op_code != RET ? "runs" : "jumps";
+
+            if (target == MIMA_TARGET_DATA)
+            {
+                log_warn("%s: 0x%08x %s into data at 0x%08x.", mima_source_location(cfg.code[address].file, cfg.code[address].line), address, how, successor);
+                result.warnings++;
+            }
+            else
+            {
+                log_error("%s: 0x%08x %s into %s at 0x%08x.", mima_source_location(cfg.code[address].file, cfg.code[address].line), address, how, mima_cfg_target_names[target], successor);
+                result.errors++;
+            }
+        }
+    }
+
+    if (!halts)
+    {
+        log_error("No HLT can be reached from 0x00000000.");
+        result.errors++;
+    }
+
+    // one warning per block of unreachable code
+    for (uint32_t address = 0; address < cfg.count; ++address)
+    {
+        if (reachable[address])
+        {
+            continue;
+        }
+
+        uint32_t end = address;
+
+        while (end + 1 < cfg.count && !reachable[end + 1])
+        {
+            end++;
+        }
+
+        log_warn("%s: 0x%08x - 0x%08x is unreachable.", mima_source_location(cfg.code[address].file, cfg.code[address].line), address, end);
+        result.warnings++;
+        address = end;
+    }
+
+    mima_cfg_find_dead_loops(&cfg, reachable, &result);
+
+    log_info("Analysis: %u error(s), %u warning(s).", result.errors, result.warnings);
+
+    free(cfg.returns);
+    free(worklist);
+    free(reachable);
+
+    return result;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mima_cache.h"
+#include "log.h"
+
+#define MIMA_CACHE_MISSES_INITIAL_CAPACITY 1024
+
+static mima_bool mima_cache_power_of_two(uint32_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+mima_cache *mima_cache_create(const char *config)
+{
+    uint32_t size_words, ways, line_words;
+    char policy[8] = "wb";
+
+    int fields = sscanf(config, "%u,%u,%u,%7s", &size_words, &ways, &line_words, policy);
+
+    if (fields < 3 || (strcmp(policy, "wb") != 0 && strcmp(policy, "wt") != 0))
+    {
+        log_error("Expected cache size,ways,line[,wb|wt], got %s", config);
+        return NULL;
+    }
+
+    if (!mima_cache_power_of_two(size_words) || !mima_cache_power_of_two(ways) || !mima_cache_power_of_two(line_words) || ways * line_words > size_words)
+    {
+        log_error("Cache size, ways and line size must be powers of two with ways * line <= size :(");
+        return NULL;
+    }
+
+    mima_cache *cache = calloc(1, sizeof(mima_cache));
+
+    if (!cache)
+    {
+        log_error("Could not allocate the cache model :(");
+        return NULL;
+    }
+
+    cache->size_words = size_words;
+    cache->ways = ways;
+    cache->line_words = line_words;
+    cache->line_words_log2 = __builtin_ctz(line_words);
+    cache->sets = size_words / (ways * line_words);
+    cache->write_back = strcmp(policy, "wb") == 0;
+    cache->lines = calloc((size_t)cache->sets * ways, sizeof(mima_cache_line));
+    cache->misses_capacity = MIMA_CACHE_MISSES_INITIAL_CAPACITY;
+    cache->misses = calloc(cache->misses_capacity, sizeof(mima_cache_miss));
+
+    if (!cache->lines || !cache->misses)
+    {
+        log_error("Could not allocate the cache model :(");
+        mima_cache_delete(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void mima_cache_delete(mima_cache *cache)
+{
+    if (!cache)
+    {
+        return;
+    }
+
+    free(cache->lines);
+    free(cache->misses);
+    free(cache);
+}
+
+static mima_cache_miss *mima_cache_miss_slot(mima_cache_miss *misses, uint32_t capacity, mima_register address)
+{
+    uint32_t index = (uint32_t)((address * 2654435761u) & (capacity - 1));
+
+    while (misses[index].address != 0 && misses[index].address != address + 1)
+    {
+        index = (index + 1) & (capacity - 1);
+    }
+
+    return &misses[index];
+}
+
+static void mima_cache_count_miss(mima_cache *cache, mima_register address)
+{
+    // keep the table at most half full
+    if (2 * (cache->misses_count + 1) > cache->misses_capacity)
+    {
+        uint32_t capacity = cache->misses_capacity * 2;
+        mima_cache_miss *misses = calloc(capacity, sizeof(mima_cache_miss));
+
+        if (!misses)
+        {
+            // the counters stay correct, only the report loses addresses
+            return;
+        }
+
+        for (uint32_t i = 0; i < cache->misses_capacity; ++i)
+        {
+            if (cache->misses[i].address != 0)
+            {
+                *mima_cache_miss_slot(misses, capacity, cache->misses[i].address - 1) = cache->misses[i];
+            }
+        }
+
+        free(cache->misses);
+        cache->misses = misses;
+        cache->misses_capacity = capacity;
+    }
+
+    mima_cache_miss *miss = mima_cache_miss_slot(cache->misses, cache->misses_capacity, address);
+
+    if (miss->address == 0)
+    {
+        miss->address = address + 1;
+        cache->misses_count++;
+    }
+
+    miss->count++;
+}
+
+mima_bool mima_cache_access(mima_cache *cache, mima_register address, mima_bool write)
+{
+    uint32_t line = address >> cache->line_words_log2;
+    mima_cache_line *set = &cache->lines[(size_t)(line & (cache->sets - 1)) * cache->ways];
+    mima_cache_line *victim = &set[0];
+
+    cache->clock++;
+
+    if (write)
+    {
+        cache->writes++;
+    }
+    else
+    {
+        cache->reads++;
+    }
+
+    for (uint32_t way = 0; way < cache->ways; ++way)
+    {
+        if (set[way].valid && set[way].line == line)
+        {
+            set[way].last_use = cache->clock;
+            set[way].dirty |= write && cache->write_back;
+            return mima_true;
+        }
+
+        // invalid lines first, then the least recently used one
+        if (victim->valid && (!set[way].valid || set[way].last_use < victim->last_use))
+        {
+            victim = &set[way];
+        }
+    }
+
+    if (write)
+    {
+        cache->write_misses++;
+    }
+    else
+    {
+        cache->read_misses++;
+    }
+
+    mima_cache_count_miss(cache, address);
+
+    // write through does not allocate on a write miss
+    if (write && !cache->write_back)
+    {
+        return mima_false;
+    }
+
+    if (victim->valid)
+    {
+        cache->evictions++;
+
+        if (victim->dirty)
+        {
+            cache->write_backs++;
+        }
+    }
+
+    victim->line = line;
+    victim->last_use = cache->clock;
+    victim->valid = mima_true;
+    victim->dirty = write;
+
+    return mima_false;
+}
+
+static int mima_cache_compare_misses(const void *a, const void *b)
+{
+    const mima_cache_miss *left = a;
+    const mima_cache_miss *right = b;
+
+    if (left->count != right->count)
+    {
+        return left->count < right->count ? 1 : -1;
+    }
+
+    return left->address < right->address ? -1 : left->address > right->address;
+}
+
+void mima_cache_print_stats(mima_cache *cache, uint32_t count)
+{
+    uint64_t accesses = cache->reads + cache->writes;
+    uint64_t misses = cache->read_misses + cache->write_misses;
+
+    printf("\n");
+    printf("=======CACHE=============\n");
+    printf(" MODEL\t    = %u words, %u way, %u words per line, %s\n", cache->size_words, cache->ways, cache->line_words, cache->write_back ? "write back" : "write through");
+    printf(" READS\t    = %llu (%llu misses)\n", (unsigned long long)cache->reads, (unsigned long long)cache->read_misses);
+    printf(" WRITES\t    = %llu (%llu misses)\n", (unsigned long long)cache->writes, (unsigned long long)cache->write_misses);
+    printf(" HIT RATE    = %.2f%%\n", accesses ? 100.0 * (accesses - misses) / accesses : 0.0);
+    printf(" EVICTIONS   = %llu (%llu write backs)\n", (unsigned long long)cache->evictions, (unsigned long long)cache->write_backs);
+
+    if (count > 0 && cache->misses_count > 0)
+    {
+        mima_cache_miss *sorted = malloc(cache->misses_count * sizeof(mima_cache_miss));
+
+        if (sorted)
+        {
+            uint32_t used = 0;
+
+            for (uint32_t i = 0; i < cache->misses_capacity; ++i)
+            {
+                if (cache->misses[i].address != 0)
+                {
+                    sorted[used++] = cache->misses[i];
+                }
+            }
+
+            qsort(sorted, used, sizeof(mima_cache_miss), mima_cache_compare_misses);
+
+            printf(" MISSES BY ADDRESS\n");
+
+            for (uint32_t i = 0; i < used && i < count; ++i)
+            {
+                printf("  0x%08x  %llu\n", sorted[i].address - 1, (unsigned long long)sorted[i].count);
+            }
+
+            free(sorted);
+        }
+    }
+
+    printf("=========================\n");
+}
@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mima_checkpoint.h"
+#include "mima_interrupts.h"
+#include "mima_iolog.h"
+#include "mima_memory.h"
+#include "log.h"
+
+static const char mima_checkpoint_magic[8] = { 'M', 'I', 'M', 'A', 'C', 'K', 'P', '1' };
+
+typedef struct _mima_checkpoint_header
+{
+    char		magic[8];
+    uint64_t	sequence;
+    uint32_t	state_size;
+    uint32_t	pages;
+} mima_checkpoint_header;
+
+static mima_bool mima_checkpoint_write(mima_checkpoint *checkpoint)
+{
+    char file_name[4096 + 32];
+    char temporary[4096 + 32];
+    snprintf(file_name, sizeof(file_name), "%s.%u", checkpoint->file_name, (uint32_t)(checkpoint->sequence % checkpoint->keep));
+    snprintf(temporary, sizeof(temporary), "%s.tmp", checkpoint->file_name);
+
+    FILE *file = fopen(temporary, "wb");
+
+    if (!file)
+    {
+        log_error("Failed to open %s :(", temporary);
+        return mima_false;
+    }
+
+    mima_checkpoint_header header = { .sequence = checkpoint->sequence, .state_size = sizeof(mima_checkpoint_state), .pages = checkpoint->pages_count };
+    memcpy(header.magic, mima_checkpoint_magic, sizeof(header.magic));
+
+    mima_bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&checkpoint->state, sizeof(checkpoint->state), 1, file) == 1;
+
+    // every pending page has to be read, otherwise the engine keeps copying it
+    static mima_word words[mima_page_words];
+    for (uint32_t page = 0; page < mima_pages; ++page)
+    {
+        if ((checkpoint->pages[page >> 6] >> (page & 63)) & 1)
+        {
+            mima_memory_snapshot_read_page(checkpoint->memory_unit, page, words);
+            written = written && fwrite(&page, sizeof(page), 1, file) == 1 && fwrite(words, sizeof(words), 1, file) == 1;
+        }
+    }
+
+    // the checkpoint has to survive a crash of the host, too
+    written = written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+
+    if (fclose(file) != 0 || !written || rename(temporary, file_name) != 0)
+    {
+        log_error("Failed to write checkpoint %s :(", file_name);
+        remove(temporary);
+        return mima_false;
+    }
+
+    log_info("Checkpoint %llu written to %s (%u pages).", (unsigned long long)checkpoint->sequence, file_name, checkpoint->pages_count);
+    return mima_true;
+}
+
+static void *mima_checkpoint_writer(void *argument)
+{
+    mima_checkpoint *checkpoint = argument;
+
+    pthread_mutex_lock(&checkpoint->mutex);
+
+    while (mima_true)
+    {
+        while (!checkpoint->busy && !checkpoint->quit)
+        {
+            pthread_cond_wait(&checkpoint->condition, &checkpoint->mutex);
+        }
+
+        // a snapshot that was taken is always written
+        if (!checkpoint->busy)
+        {
+            break;
+        }
+
+        pthread_mutex_unlock(&checkpoint->mutex);
+        mima_bool written = mima_checkpoint_write(checkpoint);
+        pthread_mutex_lock(&checkpoint->mutex);
+
+        checkpoint->written += written;
+        checkpoint->busy = mima_false;
+        pthread_cond_signal(&checkpoint->condition);
+    }
+
+    pthread_mutex_unlock(&checkpoint->mutex);
+    return NULL;
+}
+
+// file[,every[s][,keep]]
+mima_checkpoint *mima_checkpoint_create(const char *config, mima_t *mima)
+{
+    mima_checkpoint *checkpoint = calloc(1, sizeof(mima_checkpoint));
+
+    if (!checkpoint)
+    {
+        return NULL;
+    }
+
+    size_t length = strcspn(config, ",");
+    snprintf(checkpoint->file_name, sizeof(checkpoint->file_name), "%.*s", (int)length, config);
+    checkpoint->every_instructions = 10000000;
+    checkpoint->keep = 3;
+
+    if (config[length] == ',')
+    {
+        char *end;
+        uint64_t every = strtoull(&config[length + 1], &end, 0);
+
+        if (*end == 's')
+        {
+            checkpoint->every_instructions = 0;
+            checkpoint->every_seconds = every;
+            end++;
+        }
+        else
+        {
+            checkpoint->every_instructions = every;
+        }
+
+        if (*end == ',')
+        {
+            checkpoint->keep = strtoul(end + 1, &end, 0);
+        }
+
+        if (*end != 0 || every == 0 || checkpoint->keep == 0 || checkpoint->keep > MIMA_CHECKPOINT_MAX_KEEP)
+        {
+            log_error("Expected file[,every[s][,keep]] with 1 - %d files to keep, got %s", MIMA_CHECKPOINT_MAX_KEEP, config);
+            free(checkpoint);
+            return NULL;
+        }
+    }
+
+    checkpoint->memory_unit = &mima->memory_unit;
+    checkpoint->pages = calloc((mima_pages + 63) / 64, sizeof(uint64_t));
+    checkpoint->last = time(NULL);
+    checkpoint->due = mima->counters.instructions + (checkpoint->every_instructions ? checkpoint->every_instructions : MIMA_CHECKPOINT_POLL);
+    pthread_mutex_init(&checkpoint->mutex, NULL);
+    pthread_cond_init(&checkpoint->condition, NULL);
+
+    if (!checkpoint->pages || pthread_create(&checkpoint->thread, NULL, mima_checkpoint_writer, checkpoint) != 0)
+    {
+        log_error("Could not start the checkpoint writer :(");
+        pthread_mutex_destroy(&checkpoint->mutex);
+        pthread_cond_destroy(&checkpoint->condition);
+        free(checkpoint->pages);
+        free(checkpoint);
+        return NULL;
+    }
+
+    return checkpoint;
+}
+
+void mima_checkpoint_delete(mima_checkpoint *checkpoint, mima_t *mima)
+{
+    if (!checkpoint)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&checkpoint->mutex);
+    checkpoint->quit = mima_true;
+    pthread_cond_signal(&checkpoint->condition);
+    pthread_mutex_unlock(&checkpoint->mutex);
+    pthread_join(checkpoint->thread, NULL);
+
+    mima_memory_snapshot_end(&mima->memory_unit);
+    log_info("Wrote %llu checkpoint(s).", (unsigned long long)checkpoint->written);
+
+    pthread_mutex_destroy(&checkpoint->mutex);
+    pthread_cond_destroy(&checkpoint->condition);
+    free(checkpoint->pages);
+    free(checkpoint);
+}
+
+void mima_checkpoint_tick(mima_checkpoint *checkpoint, mima_t *mima)
+{
+    uint64_t instructions = mima->counters.instructions;
+    time_t now = time(NULL);
+
+    if (checkpoint->every_seconds && now - checkpoint->last < checkpoint->every_seconds)
+    {
+        checkpoint->due = instructions + MIMA_CHECKPOINT_POLL;
+        return;
+    }
+
+    pthread_mutex_lock(&checkpoint->mutex);
+
+    // the writer is still busy with the previous one -> try again a little later instead of waiting,
+    // a whole interval behind the engine waits for it, so the configured cadence is kept
+    if (checkpoint->busy && checkpoint->every_instructions && instructions - checkpoint->state.counters.instructions >= 2 * checkpoint->every_instructions)
+    {
+        while (checkpoint->busy)
+        {
+            pthread_cond_wait(&checkpoint->condition, &checkpoint->mutex);
+        }
+    }
+    else if (checkpoint->busy)
+    {
+        pthread_mutex_unlock(&checkpoint->mutex);
+        checkpoint->due = instructions + (checkpoint->every_instructions && checkpoint->every_instructions < MIMA_CHECKPOINT_POLL ? checkpoint->every_instructions : MIMA_CHECKPOINT_POLL);
+        return;
+    }
+
+    mima_memory_snapshot_end(&mima->memory_unit);
+
+    mima_checkpoint_state *state = &checkpoint->state;
+    memcpy(&state->control_unit, &mima->control_unit, sizeof(mima_control_unit));
+    memcpy(&state->processing_unit, &mima->processing_unit, sizeof(mima_processing_unit));
+    state->SIR = mima->memory_unit.SIR;
+    state->SAR = mima->memory_unit.SAR;
+    state->current_instruction = mima->current_instruction;
+    state->counters = mima->counters;
+    state->dma = mima->dma;
+    state->interrupts = (mima_interrupt_controller)
+    {
+        .enabled = mima->interrupts.enabled,
+        .active = mima->interrupts.active,
+        .vector = mima->interrupts.vector,
+        .mask = mima->interrupts.mask,
+        .pending = __atomic_load_n(&mima->interrupts.pending, __ATOMIC_SEQ_CST),
+        .period = mima->interrupts.period,
+        .next_tick = mima->interrupts.next_tick,
+        .saved_IAR = mima->interrupts.saved_IAR,
+        .saved_ACC = mima->interrupts.saved_ACC,
+        .delivered = mima->interrupts.delivered,
+    };
+    state->io_log_offset = mima->io_log ? mima_io_log_tell(mima->io_log) : 0;
+    state->io_log_instruction = mima->io_log ? mima->io_log->instruction : 0;
+    state->io_log_records = mima->io_log ? mima->io_log->records : 0;
+
+    checkpoint->pages_count = mima_memory_snapshot_begin(&mima->memory_unit, checkpoint->pages);
+    checkpoint->sequence++;
+    checkpoint->busy = mima_true;
+    pthread_cond_signal(&checkpoint->condition);
+    pthread_mutex_unlock(&checkpoint->mutex);
+
+    checkpoint->last = now;
+    checkpoint->due = instructions + (checkpoint->every_instructions ? checkpoint->every_instructions : MIMA_CHECKPOINT_POLL);
+}
+
+static mima_bool mima_checkpoint_read_header(const char *file_name, FILE **file, mima_checkpoint_header *header)
+{
+    *file = fopen(file_name, "rb");
+
+    if (!*file)
+    {
+        return mima_false;
+    }
+
+    if (fread(header, sizeof(*header), 1, *file) != 1 || memcmp(header->magic, mima_checkpoint_magic, sizeof(header->magic)) != 0 ||
+        header->state_size != sizeof(mima_checkpoint_state))
+    {
+        log_warn("%s is not a checkpoint of this MimaSim, ignoring it.", file_name);
+        fclose(*file);
+        return mima_false;
+    }
+
+    return mima_true;
+}
+
+mima_bool mima_checkpoint_resume(mima_t *mima, const char *file_name)
+{
+    // the reads before the checkpoint would be missing from the new recording
+    if (mima->io_log && !mima->io_log->replay)
+    {
+        log_error("A new recording cannot continue at a checkpoint, resume with --replay of the original one :(");
+        return mima_false;
+    }
+
+    char newest[4096 + 32] = {0};
+    uint64_t sequence = 0;
+
+    for (uint32_t i = 0; i < MIMA_CHECKPOINT_MAX_KEEP; ++i)
+    {
+        char candidate[4096 + 32];
+        snprintf(candidate, sizeof(candidate), "%s.%u", file_name, i);
+
+        FILE *file;
+        mima_checkpoint_header header;
+
+        if (mima_checkpoint_read_header(candidate, &file, &header))
+        {
+            if (header.sequence > sequence)
+            {
+                sequence = header.sequence;
+                strcpy(newest, candidate);
+            }
+
+            fclose(file);
+        }
+    }
+
+    FILE *file;
+    mima_checkpoint_header header;
+
+    if (sequence == 0 || !mima_checkpoint_read_header(newest, &file, &header))
+    {
+        log_error("There is no checkpoint %s.# to resume from :(", file_name);
+        return mima_false;
+    }
+
+    mima_checkpoint_state state;
+    static mima_word words[mima_page_words];
+    mima_bool complete = fread(&state, sizeof(state), 1, file) == 1;
+
+    for (uint32_t i = 0; complete && i < header.pages; ++i)
+    {
+        uint32_t page;
+        complete = fread(&page, sizeof(page), 1, file) == 1 && page < mima_pages && fread(words, sizeof(words), 1, file) == 1;
+
+        if (complete)
+        {
+            mima_memory_write_block(&mima->memory_unit, page << mima_page_words_log2, words, mima_page_words);
+        }
+    }
+
+    fclose(file);
+
+    if (!complete)
+    {
+        log_error("Checkpoint %s is damaged :(", newest);
+        return mima_false;
+    }
+
+    // the replay continues with the first read after the checkpoint
+    if (mima->io_log && !mima_io_log_seek(mima->io_log, state.io_log_offset, state.io_log_instruction, state.io_log_records))
+    {
+        log_error("Checkpoint %s was not taken along a recording, it cannot be replayed :(", newest);
+        return mima_false;
+    }
+
+    memcpy(&mima->control_unit, &state.control_unit, sizeof(mima_control_unit));
+    memcpy(&mima->processing_unit, &state.processing_unit, sizeof(mima_processing_unit));
+    mima->memory_unit.SIR = state.SIR;
+    mima->memory_unit.SAR = state.SAR;
+    mima->current_instruction = state.current_instruction;
+    mima->counters = state.counters;
+
+    // the DMA configuration comes from the command line, its registers from the checkpoint
+    mima->dma.source = state.dma.source;
+    mima->dma.destination = state.dma.destination;
+    mima->dma.length = state.dma.length;
+    mima->dma.transfers = state.dma.transfers;
+    mima->dma.words = state.dma.words;
+
+    // so does the interrupt controller, the input thread starts again if the program enabled input
+    mima_interrupt_controller *interrupts = &mima->interrupts;
+
+    if (interrupts->enabled)
+    {
+        interrupts->active = state.interrupts.active;
+        interrupts->vector = state.interrupts.vector;
+        interrupts->pending = state.interrupts.pending;
+        interrupts->period = state.interrupts.period;
+        interrupts->next_tick = state.interrupts.next_tick;
+        interrupts->saved_IAR = state.interrupts.saved_IAR;
+        interrupts->saved_ACC = state.interrupts.saved_ACC;
+        interrupts->delivered = state.interrupts.delivered;
+        mima_interrupts_write(mima, mima_irq_enable, state.interrupts.mask);
+    }
+    else if (state.interrupts.enabled)
+    {
+        log_warn("Checkpoint %s was taken with --interrupts, the program continues without them.", newest);
+    }
+
+    // continue the rotation after the checkpoint we resumed from
+    if (mima->checkpoint)
+    {
+        mima->checkpoint->sequence = sequence;
+        mima->checkpoint->due = mima->counters.instructions + (mima->checkpoint->every_instructions ? mima->checkpoint->every_instructions : MIMA_CHECKPOINT_POLL);
+    }
+
+    log_info("Resumed from %s (checkpoint %llu, %llu instructions).", newest, (unsigned long long)sequence, (unsigned long long)mima->counters.instructions);
+    return mima_true;
+}
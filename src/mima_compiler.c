@@ -2,14 +2,26 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "mima.h"
 #include "mima_compiler.h"
+#include "mima_memory.h"
+#include "mima_memscan.h"
+#include "mima_preprocessor.h"
+#include "mima_optimizer.h"
 #include "log.h"
 
 const char* delimiter = " \n\r";
 
 uint32_t labels_count = 0;
+uint32_t mima_labels_generation = 0;
 uint32_t labels_capacity = INITIAL_LABEL_CAPACITY;
+mima_label *mima_labels = NULL;
 
 mima_bool mima_string_to_number(const char *string, uint32_t *number)
 {
@@ -110,6 +122,42 @@ mima_bool mima_string_to_op_code(const char *op_code_string, uint32_t *op_code)
     {
         op_code_result = RRN;
     }
+    else if (!mima_extended_isa)
+    {
+        // MUL - RET are plain words (comments) without --extended-isa
+    }
+    else if (mima_string_starts_with_insensitive(op_code_string, "mul"))
+    {
+        op_code_result = MUL;
+    }
+    else if (mima_string_starts_with_insensitive(op_code_string, "sub"))
+    {
+        op_code_result = SUB;
+    }
+    else if (mima_string_starts_with_insensitive(op_code_string, "shl"))
+    {
+        op_code_result = SHL;
+    }
+    else if (mima_string_starts_with_insensitive(op_code_string, "shr"))
+    {
+        op_code_result = SHR;
+    }
+    else if (mima_string_starts_with_insensitive(op_code_string, "ldiv"))
+    {
+        op_code_result = LDIV;
+    }
+    else if (mima_string_starts_with_insensitive(op_code_string, "stiv"))
+    {
+        op_code_result = STIV;
+    }
+    else if (mima_string_starts_with_insensitive(op_code_string, "call"))
+    {
+        op_code_result = CALL;
+    }
+    else if (mima_string_starts_with_insensitive(op_code_string, "ret"))
+    {
+        op_code_result = RET;
+    }
 
     if (op_code_result == -1)
     {
@@ -125,21 +173,333 @@ mima_bool mima_string_to_op_code(const char *op_code_string, uint32_t *op_code)
     return mima_true;
 }
 
-void mima_scan_for_labels(FILE *file)
+// "address value" lines and the data directives, a block of count words from address on
+typedef struct _mima_deferred_store
+{
+    uint32_t address;
+    uint32_t count;
+    mima_word value;    // fills the block if there is no data
+    mima_word *data;
+    size_t position;    // instructions emitted by this chunk before the store
+    uint32_t line;
+    uint64_t label_words[2];    // .word values that are label addresses, the optimizer relocates them
+} mima_deferred_store;
+
+typedef struct _mima_chunk_label
+{
+    mima_label label;
+    size_t line;        // line number local to the chunk
+} mima_chunk_label;
+
+typedef struct _mima_compile_chunk
+{
+    const char *begin;
+    const char *end;
+
+    // pass 1: labels and instruction count
+    size_t line_base;
+    size_t line_count;
+    size_t scan_address_base;
+    size_t scan_instruction_count;
+    mima_chunk_label *labels;
+    uint32_t labels_count;
+    uint32_t labels_capacity;
+
+    // pass 2: encoded instructions and storage definitions
+    size_t address_base;
+    size_t instruction_count;
+    mima_word *instructions;
+    uint32_t *instruction_lines;
+    uint8_t *label_operands;
+    mima_deferred_store *stores;
+    size_t stores_count;
+    size_t stores_capacity;
+    size_t error;
+
+    mima_memory_unit *memory_unit;
+} mima_compile_chunk;
+
+typedef struct _mima_sorted_store
+{
+    mima_image_entry entry;
+    size_t sequence;    // qsort is not stable, this keeps the source order of duplicate addresses
+} mima_sorted_store;
+
+mima_image mima_assembled_image = {0};
+static char source_file_name[4096] = {0};
+
+// file being assembled, .incbin paths are relative to it
+static const char *assemble_file_name = NULL;
+
+static uint32_t *label_index = NULL;
+static uint32_t label_index_count = 0;
+
+// "#line 12 "lib/print.asm"" of the preprocessor: the next assembled line is line 12 of that file
+typedef struct _mima_source_marker
+{
+    size_t assembled_line;
+    uint32_t file;
+    uint32_t line;
+} mima_source_marker;
+
+// where the lines of the assembled text came from, empty if the source had no directives
+typedef struct _mima_source_map
+{
+    mima_source_marker *markers;
+    size_t markers_count;
+    char **files;
+    uint32_t files_count;
+} mima_source_map;
+
+static mima_source_map source_map = {0};
+
+// Reads the next line the same way fgets(line, size, file) would:
+// at most size - 1 chars, including the newline if it fits.
+static mima_bool mima_next_line(const char **cursor, const char *end, char *line, size_t size)
+{
+    const char *begin = *cursor;
+
+    if (begin >= end)
+    {
+        return mima_false;
+    }
+
+    size_t length = end - begin;
+
+    if (length > size - 1)
+    {
+        length = size - 1;
+    }
+
+    const char *newline = memchr(begin, '\n', length);
+
+    if (newline)
+    {
+        length = newline - begin + 1;
+    }
+
+    memcpy(line, begin, length);
+    line[length] = 0;
+    *cursor = begin + length;
+
+    return mima_true;
+}
+
+static void mima_source_map_free(mima_source_map *map)
+{
+    for (uint32_t i = 0; i < map->files_count; ++i)
+    {
+        free(map->files[i]);
+    }
+
+    free(map->files);
+    free(map->markers);
+    memset(map, 0, sizeof(mima_source_map));
+}
+
+static uint32_t mima_source_map_file(mima_source_map *map, const char *name, size_t length)
+{
+    // markers of one file follow each other, the last one is the most likely
+    for (uint32_t i = map->files_count; i-- > 0;)
+    {
+        if (strlen(map->files[i]) == length && strncmp(map->files[i], name, length) == 0)
+        {
+            return i;
+        }
+    }
+
+    char **files = realloc(map->files, (map->files_count + 1) * sizeof(char *));
+    char *file = malloc(length + 1);
+
+    if (!files || !file)
+    {
+        log_fatal("Could not allocate memory for the source map :(");
+        assert(0);
+    }
+
+    memcpy(file, name, length);
+    file[length] = 0;
+    map->files = files;
+    map->files[map->files_count] = file;
+    return map->files_count++;
+}
+
+// Collects the line markers of an expansion, lines are counted exactly like the assembler counts them.
+static void mima_source_map_build(mima_source_map *map, const char *source, size_t size)
+{
+    const char *cursor = source;
+    const char *end = source + size;
+    size_t capacity = 0;
+    size_t line_number = 0;
+    char line[256];
+
+    const char *begin = cursor;
+    while (mima_next_line(&cursor, end, line, sizeof(line)))
+    {
+        line_number++;
+
+        // the path may be longer than the line buffer, it is read from the source itself
+        unsigned long marked_line;
+        char *quote;
+
+        if (strncmp(line, "#line ", 6) == 0 && (marked_line = strtoul(&line[6], &quote, 10)) > 0 && quote[0] == ' ' && quote[1] == '"')
+        {
+            const char *name = begin + (quote + 2 - line);
+            const char *line_end = memchr(name, '\n', end - name);
+            const char *name_end = line_end ? line_end : end;
+
+            while (name_end > name && name_end[-1] != '"')
+            {
+                name_end--;
+            }
+
+            if (map->markers_count + 1 > capacity)
+            {
+                capacity = capacity ? capacity * 2 : 64;
+                map->markers = realloc(map->markers, capacity * sizeof(mima_source_marker));
+
+                if (!map->markers)
+                {
+                    log_fatal("Could not allocate memory for the source map :(");
+                    assert(0);
+                }
+            }
+
+            mima_source_marker *marker = &map->markers[map->markers_count++];
+            marker->assembled_line = line_number;
+            marker->file = mima_source_map_file(map, name, name_end > name ? name_end - name - 1 : 0);
+            marker->line = marked_line;
+        }
+
+        begin = cursor;
+    }
+}
+
+void mima_source_position(size_t assembled_line, uint32_t *file, uint32_t *line)
+{
+    // last marker before the line
+    size_t low = 0;
+    size_t high = source_map.markers_count;
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (source_map.markers[middle].assembled_line < assembled_line)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low == 0)
+    {
+        *file = 0;
+        *line = assembled_line;
+        return;
+    }
+
+    mima_source_marker *marker = &source_map.markers[low - 1];
+    *file = marker->file;
+    *line = marker->line + (assembled_line - marker->assembled_line - 1);
+}
+
+const char *mima_source_location(uint32_t file, uint32_t line)
+{
+    // diagnostics of the chunks are logged from several threads at once
+    static __thread char location[4096 + 16];
+
+    if (file < source_map.files_count)
+    {
+        snprintf(location, sizeof(location), "%s:%u", source_map.files[file], line);
+    }
+    else
+    {
+        snprintf(location, sizeof(location), "Line %03u", line);
+    }
+
+    return location;
+}
+
+const char *mima_assembled_location(size_t assembled_line)
+{
+    uint32_t file;
+    uint32_t line;
+    mima_source_position(assembled_line, &file, &line);
+
+    return mima_source_location(file, line);
+}
+
+static void mima_chunk_push_label(mima_compile_chunk *chunk, const char *label_name, size_t address, size_t line)
+{
+    if (chunk->labels_count + 1 > chunk->labels_capacity)
+    {
+        chunk->labels_capacity = chunk->labels_capacity ? chunk->labels_capacity * 2 : INITIAL_LABEL_CAPACITY;
+        chunk->labels = realloc(chunk->labels, sizeof(mima_chunk_label) * chunk->labels_capacity);
+
+        if (!chunk->labels)
+        {
+            log_fatal("Could not allocate memory for labels :(");
+            assert(0);
+        }
+    }
+
+    // the label name is validated again when pushed to the global table
+    mima_chunk_label *label = &chunk->labels[chunk->labels_count++];
+    strncpy(label->label.label_name, label_name, 31);
+    label->label.label_name[31] = 0;
+    label->label.address = address;
+    label->line = line;
+}
+
+static void mima_chunk_push_store(mima_compile_chunk *chunk, uint32_t address, uint32_t count, mima_word value, mima_word *data, const uint64_t *label_words, size_t position, size_t line)
+{
+    if (chunk->stores_count + 1 > chunk->stores_capacity)
+    {
+        chunk->stores_capacity = chunk->stores_capacity ? chunk->stores_capacity * 2 : 64;
+        chunk->stores = realloc(chunk->stores, sizeof(mima_deferred_store) * chunk->stores_capacity);
+
+        if (!chunk->stores)
+        {
+            log_fatal("Could not allocate memory for storage definitions :(");
+            assert(0);
+        }
+    }
+
+    chunk->stores[chunk->stores_count].address = address;
+    chunk->stores[chunk->stores_count].count = count;
+    chunk->stores[chunk->stores_count].value = value;
+    chunk->stores[chunk->stores_count].data = data;
+    chunk->stores[chunk->stores_count].position = position;
+    chunk->stores[chunk->stores_count].line = line;
+    chunk->stores[chunk->stores_count].label_words[0] = label_words ? label_words[0] : 0;
+    chunk->stores[chunk->stores_count].label_words[1] = label_words ? label_words[1] : 0;
+    chunk->stores_count++;
+}
+
+static void *mima_scan_chunk_for_labels(void *argument)
 {
     // This function ignores all syntactical errors and does not log anything.
-    // All those diagnostics are applied inside "mima_compile_file()".
+    // All those diagnostics are applied inside "mima_assemble_chunk()".
     // Here, we will only look for labels.
     // But labels are placed at memory addresses.
     // As a consequence, we still have to discriminate between whitespace lines / comments and instructions, though.
+    // Addresses and line numbers are local to the chunk, they are fixed up with a prefix sum afterwards.
+
+    mima_compile_chunk *chunk = argument;
+    const char *cursor = chunk->begin;
 
     char line[256];
     size_t line_number = 0;
     size_t memory_address = 0;
-    while(fgets(line, sizeof(line), file))
+    while(mima_next_line(&cursor, chunk->end, line, sizeof(line)))
     {
         line_number++;
-        char *string = strtok(line, " \r\n");
+        char *save = NULL;
+        char *string = strtok_r(line, " \r\n", &save);
 
         if (string == NULL)
         {
@@ -157,51 +517,272 @@ void mima_scan_for_labels(FILE *file)
         // Check for labels -> safe for later and remeber line number aka address
         if (string[0] == ':')
         {
-            log_trace("Line %03zu: %3s for address 0x%08x", line_number, &string[1], memory_address);
-            mima_push_label(&string[1], memory_address, line_number);
+            mima_chunk_push_label(chunk, &string[1], memory_address, line_number);
             continue;
         }
 
         // Ignore everything else here.
     }
 
-    log_trace("Found %zu label(s) while scanning the input file.", labels_count);
+    chunk->line_count = line_number;
+    chunk->scan_instruction_count = memory_address;
+
+    return NULL;
 }
 
-mima_bool mima_compile_file(mima_t *mima, const char *file_name)
+// "text" with the escapes \n, \t, \0, \\ and \", one char per word
+static mima_word *mima_assemble_ascii(const char *string, uint32_t *count, size_t line_number)
 {
-    FILE *file = fopen(file_name, "r");
+    string += strspn(string, " \t");
 
-    if (!file)
+    if (*string != '"')
     {
-        log_error("Failed to open source code file: %s :(", file_name);
-        return mima_false;
+        log_error("%s: .ascii expects a quoted string.", mima_assembled_location(line_number));
+        return NULL;
     }
 
-    log_info("Compiling %s ...", file_name);
+    mima_word *data = malloc((strlen(string) + 1) * sizeof(mima_word));
 
-    // First, scan the file for labels.
-    // This two-pass approach allows us to use them without forward declaration.
-    mima_scan_for_labels(file);
+    if (!data)
+    {
+        log_fatal("Could not allocate memory for .ascii :(");
+        assert(0);
+    }
+
+    *count = 0;
+    for (string++; *string && *string != '"'; string++)
+    {
+        char c = *string;
+
+        if (c == '\\' && string[1])
+        {
+            c = *++string;
+            c = c == 'n' ? '\n' : c == 't' ? '\t' : c == '0' ? 0 : c;
+        }
+
+        data[(*count)++] = (uint8_t)c;
+    }
+
+    if (*string != '"')
+    {
+        log_error("%s: .ascii string is not terminated.", mima_assembled_location(line_number));
+        free(data);
+        return NULL;
+    }
+
+    return data;
+}
+
+// The words of a host file (host byte order), at most max_words if not 0.
+static mima_word *mima_assemble_incbin(const char *argument, uint32_t max_words, uint32_t *count, size_t line_number)
+{
+    char file_name[4096];
+    size_t length = strlen(argument);
+
+    // quotes are optional
+    if (length >= 2 && argument[0] == '"' && argument[length - 1] == '"')
+    {
+        argument++;
+        length -= 2;
+    }
+
+    // relative to the file the line came from, which is an included one for expansions
+    uint32_t source_file;
+    uint32_t source_line;
+    mima_source_position(line_number, &source_file, &source_line);
+
+    const char *including = source_file < source_map.files_count ? source_map.files[source_file] : assemble_file_name;
+    const char *slash = including ? strrchr(including, '/') : NULL;
+    int directory_length = argument[0] != '/' && slash ? (int)(slash - including + 1) : 0;
+    snprintf(file_name, sizeof(file_name), "%.*s%.*s", directory_length, including, (int)length, argument);
+
+    FILE *file = fopen(file_name, "rb");
+
+    if (!file)
+    {
+        log_error("%s: Failed to open %s :(", mima_assembled_location(line_number), file_name);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
     fseek(file, 0, SEEK_SET);
 
+    // a partial last word is padded with zeros
+    size_t words = size > 0 ? ((size_t)size + sizeof(mima_word) - 1) / sizeof(mima_word) : 0;
+
+    if (max_words > 0 && words > max_words)
+    {
+        words = max_words;
+        size = words * sizeof(mima_word);
+    }
+
+    if (words > mima_words)
+    {
+        log_error("%s: %s does not fit into memory.", mima_assembled_location(line_number), file_name);
+        fclose(file);
+        return NULL;
+    }
+
+    mima_word *data = calloc(words + 1, sizeof(mima_word));
+
+    if (!data || fread(data, 1, size, file) != (size_t)size)
+    {
+        log_error("%s: Failed to read %s :(", mima_assembled_location(line_number), file_name);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *count = words;
+    return data;
+}
+
+static void mima_assemble_directive(mima_compile_chunk *chunk, const char *directive, char **save, size_t position, size_t line_number)
+{
+    uint32_t address;
+    char *string = strtok_r(NULL, delimiter, save);
+
+    if (string == NULL || !mima_string_to_number(string, &address))
+    {
+        log_error("%s: %s expects an address.", mima_assembled_location(line_number), directive);
+        chunk->error++;
+        return;
+    }
+
+    uint32_t count = 0;
+    mima_word value = 0;
+    mima_word *data = NULL;
+    uint64_t label_words[2] = { 0, 0 };
+
+    if (strcmp(directive, ".word") == 0)
+    {
+        // a line has 255 chars at most -> 128 values
+        data = malloc(128 * sizeof(mima_word));
+
+        if (!data)
+        {
+            log_fatal("Could not allocate memory for .word :(");
+            assert(0);
+        }
+
+        while ((string = strtok_r(NULL, delimiter, save)) && strncmp(string, "//", 2) != 0 && string[0] != '#')
+        {
+            uint32_t word;
+
+            // labels make jump tables
+            if (!mima_string_to_number(string, &word))
+            {
+                word = mima_address_for_label(string, line_number);
+                label_words[count >> 6] |= 1ull << (count & 63);
+            }
+
+            data[count++] = word;
+        }
+    }
+    else if (strcmp(directive, ".fill") == 0 || strcmp(directive, ".zero") == 0)
+    {
+        string = strtok_r(NULL, delimiter, save);
+
+        if (string == NULL || !mima_string_to_number(string, &count))
+        {
+            log_error("%s: %s expects a word count.", mima_assembled_location(line_number), directive);
+            chunk->error++;
+            return;
+        }
+
+        if (directive[1] == 'f' && ((string = strtok_r(NULL, delimiter, save)) == NULL || !mima_string_to_number(string, &value)))
+        {
+            log_error("%s: .fill expects a value.", mima_assembled_location(line_number));
+            chunk->error++;
+            return;
+        }
+    }
+    else if (strcmp(directive, ".ascii") == 0)
+    {
+        if (!(data = mima_assemble_ascii(*save, &count, line_number)))
+        {
+            chunk->error++;
+            return;
+        }
+    }
+    else if (strcmp(directive, ".incbin") == 0)
+    {
+        string = strtok_r(NULL, delimiter, save);
+        char *words = strtok_r(NULL, delimiter, save);
+        uint32_t max_words = 0;
+
+        if (string == NULL)
+        {
+            log_error("%s: .incbin expects a file name.", mima_assembled_location(line_number));
+            chunk->error++;
+            return;
+        }
+
+        if (words && !mima_string_to_number(words, &max_words))
+        {
+            max_words = 0;
+        }
+
+        if (!(data = mima_assemble_incbin(string, max_words, &count, line_number)))
+        {
+            chunk->error++;
+            return;
+        }
+    }
+    else
+    {
+        log_error("%s: Unknown directive %s", mima_assembled_location(line_number), directive);
+        chunk->error++;
+        return;
+    }
+
+    if (address >= mima_words || count > mima_words - address)
+    {
+        log_error("%s: %s at 0x%08x does not fit into memory.", mima_assembled_location(line_number), directive, address);
+        chunk->error++;
+        free(data);
+        return;
+    }
+
+    log_trace("Line %03zu: Define mem[0x%08x - 0x%08x] (%s)", line_number, address, address + count - 1, directive);
+    mima_chunk_push_store(chunk, address, count, value, data, label_words, position, line_number);
+}
+
+static void *mima_assemble_chunk(void *argument)
+{
+    mima_compile_chunk *chunk = argument;
+    const char *cursor = chunk->begin;
+
+    // a chunk never emits more instructions than the label scan has counted
+    chunk->instructions = malloc((chunk->scan_instruction_count + 1) * sizeof(mima_word));
+    chunk->instruction_lines = malloc((chunk->scan_instruction_count + 1) * sizeof(uint32_t));
+    chunk->label_operands = malloc((chunk->scan_instruction_count + 1) * sizeof(uint8_t));
+
+    if (!chunk->instructions || !chunk->instruction_lines || !chunk->label_operands)
+    {
+        log_fatal("Could not allocate memory for assembled instructions :(");
+        assert(0);
+    }
+
     char line[256];
-    size_t line_number = 0;
+    size_t line_number = chunk->line_base;
     size_t memory_address = 0;
-    size_t error = 0;
-    while(fgets(line, sizeof(line), file))
+    while(mima_next_line(&cursor, chunk->end, line, sizeof(line)))
     {
         line_number++;
 
+        char *save = NULL;
         char *string1 = NULL;
         char *string2 = NULL;
 
-        string1 = strtok(line, " \r\n");
+        string1 = strtok_r(line, " \r\n", &save);
 
         if (string1 == NULL)
         {
-            log_warn("Line %03zu: Found nothing useful in \"%s\"", line_number, line);
-            error++;
+            log_warn("%s: Found nothing useful in \"%s\"", mima_assembled_location(line_number), line);
+            chunk->error++;
             continue;
         }
 
@@ -217,16 +798,25 @@ mima_bool mima_compile_file(mima_t *mima, const char *file_name)
         if (mima_string_to_op_code(string1, &op_code))
         {
             uint32_t value = 0;
+            uint8_t label_operand = 0;
 
             // parse value if available
-            if (op_code != NOT && op_code != HLT && op_code != RAR)
+            if (op_code != NOT && op_code != HLT && op_code != RAR && op_code != RET)
             {
-                string2 = strtok(NULL, delimiter);
+                string2 = strtok_r(NULL, delimiter, &save);
+
+                if (string2 == NULL)
+                {
+                    log_error("%s: %s expects a value or label.", mima_assembled_location(line_number), mima_get_instruction_name(op_code));
+                    chunk->error++;
+                    continue;
+                }
 
                 if (!mima_string_to_number(string2, &value))
                 {
                     // could not parse number string -> is there a label?
                     value = mima_address_for_label(&string2[0], line_number);
+                    label_operand = 1;
                 }
             }
 
@@ -234,13 +824,15 @@ mima_bool mima_compile_file(mima_t *mima, const char *file_name)
 
             if (!mima_assemble_instruction(&instruction, op_code, value, line_number))
             {
-                log_error("Line %03zu: Could not assemble instruction: %s", line_number, line);
-                error++;
+                log_error("%s: Could not assemble instruction: %s", mima_assembled_location(line_number), line);
+                chunk->error++;
                 continue;
             }
 
-            log_trace("Line %03zu: %3s 0x%08x -> stored at mem[0x%08x]", line_number, mima_get_instruction_name(op_code), value, memory_address);
-            mima->memory_unit.memory[memory_address++] = instruction;
+            log_trace("Line %03zu: %3s 0x%08x -> stored at mem[0x%08x]", line_number, mima_get_instruction_name(op_code), value, (uint32_t)(chunk->scan_address_base + memory_address));
+            chunk->instruction_lines[memory_address] = line_number;
+            chunk->label_operands[memory_address] = label_operand;
+            chunk->instructions[memory_address++] = instruction;
             continue;
         }
 
@@ -250,23 +842,30 @@ mima_bool mima_compile_file(mima_t *mima, const char *file_name)
             continue;
         }
 
-        // define storage: address + hexnumber
-        if (mima_string_to_number(string1, &op_code))
+        // data directive: .word, .fill, .zero, .ascii, .incbin
+        if (string1[0] == '.')
+        {
+            mima_assemble_directive(chunk, string1, &save, memory_address, line_number);
+            continue;
+        }
+
+        // define storage: address + hexnumber
+        if (mima_string_to_number(string1, &op_code))
         {
             uint32_t value = 0;
 
-            string2 = strtok(NULL, delimiter);
+            string2 = strtok_r(NULL, delimiter, &save);
 
-            if (!mima_string_to_number(string2, &value))
+            if (string2 == NULL || !mima_string_to_number(string2, &value))
             {
-                log_error("Found address at line %d - value should follow, but did not.", line_number);
-                error++;
+                log_error("%s: Found an address - value should follow, but did not.", mima_assembled_location(line_number));
+                chunk->error++;
             }
 
             log_trace("Line %03zu: Define mem[0x%08x] = 0x%08x", line_number, op_code, value);
 
             // op_code holds the address in this case
-            mima->memory_unit.memory[op_code] = value;
+            mima_chunk_push_store(chunk, op_code, 1, value, NULL, NULL, memory_address, line_number);
             continue;
         }
 
@@ -279,15 +878,464 @@ mima_bool mima_compile_file(mima_t *mima, const char *file_name)
 
         // TODO: Breakpoints
 
-        log_warn("Line %03zu: Ignoring - \"%s\"", line_number, line);
+        log_warn("%s: Ignoring - \"%s\"", mima_assembled_location(line_number), line);
+    }
+
+    chunk->instruction_count = memory_address;
+
+    return NULL;
+}
+
+static void *mima_emit_chunk(void *argument)
+{
+    mima_compile_chunk *chunk = argument;
+
+    memcpy(&chunk->memory_unit->memory[chunk->address_base], chunk->instructions, chunk->instruction_count * sizeof(mima_word));
+
+    return NULL;
+}
+
+static void mima_run_chunks(mima_compile_chunk *chunks, uint32_t count, void *(*function)(void *))
+{
+    pthread_t threads[MIMA_PARALLEL_COMPILE_MAX_THREADS];
+    mima_bool started[MIMA_PARALLEL_COMPILE_MAX_THREADS] = {0};
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    // the first chunk is always processed by the calling thread
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        started[i] = pthread_create(&threads[i], NULL, function, &chunks[i]) == 0;
+
+        if (!started[i])
+        {
+            function(&chunks[i]);
+        }
+    }
+
+    function(&chunks[0]);
+
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+static int mima_compare_label_index(const void *a, const void *b)
+{
+    uint32_t index_a = *(const uint32_t *)a;
+    uint32_t index_b = *(const uint32_t *)b;
+    int result = strcmp(mima_labels[index_a].label_name, mima_labels[index_b].label_name);
+
+    if (result != 0)
+    {
+        return result;
+    }
+
+    // keep declaration order for duplicates -> the first declaration wins
+    return (index_a > index_b) - (index_a < index_b);
+}
+
+static void mima_build_label_index()
+{
+    free(label_index);
+    label_index = malloc((labels_count + 1) * sizeof(uint32_t));
+
+    if (!label_index)
+    {
+        log_fatal("Could not allocate memory for the label index :(");
+        assert(0);
+    }
+
+    for (uint32_t i = 0; i < labels_count; ++i)
+    {
+        label_index[i] = i;
+    }
+
+    qsort(label_index, labels_count, sizeof(uint32_t), mima_compare_label_index);
+    label_index_count = labels_count;
+
+    // tells the disassembler that its label names are stale
+    mima_labels_generation++;
+}
+
+static uint32_t mima_compile_thread_count(size_t size, uint32_t threads)
+{
+    if (threads == 0)
+    {
+        if (size < MIMA_PARALLEL_COMPILE_THRESHOLD)
+        {
+            return 1;
+        }
+
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (uint32_t)cpus : 1;
+
+        if (threads > size / MIMA_PARALLEL_COMPILE_MIN_CHUNK)
+        {
+            threads = size / MIMA_PARALLEL_COMPILE_MIN_CHUNK;
+        }
     }
 
+    if (threads > MIMA_PARALLEL_COMPILE_MAX_THREADS)
+    {
+        threads = MIMA_PARALLEL_COMPILE_MAX_THREADS;
+    }
+
+    return threads > 0 ? threads : 1;
+}
+
+static int mima_compare_sorted_stores(const void *a, const void *b)
+{
+    const mima_sorted_store *store_a = a;
+    const mima_sorted_store *store_b = b;
+
+    if (store_a->entry.address != store_b->entry.address)
+    {
+        return store_a->entry.address < store_b->entry.address ? -1 : 1;
+    }
+
+    return (store_a->sequence > store_b->sequence) - (store_a->sequence < store_b->sequence);
+}
+
+// Runs the peephole optimizer over the code of all chunks, returns the new number of instructions.
+static size_t mima_optimize_chunks(mima_compile_chunk *chunks, uint32_t chunks_count, size_t instructions_count)
+{
+    // storage definitions inside of the code would have to move along with it
+    for (uint32_t i = 0; i < chunks_count; ++i)
+    {
+        for (size_t j = 0; j < chunks[i].stores_count; ++j)
+        {
+            if (chunks[i].stores[j].address < instructions_count)
+            {
+                log_info("%s: Storage definition inside of the code, not optimizing.", mima_assembled_location(chunks[i].stores[j].line));
+                return instructions_count;
+            }
+        }
+    }
+
+    // patterns and relocations cross chunk borders -> all code goes into the first chunk
+    mima_compile_chunk *first = &chunks[0];
+    first->instructions = realloc(first->instructions, (instructions_count + 1) * sizeof(mima_word));
+    first->instruction_lines = realloc(first->instruction_lines, (instructions_count + 1) * sizeof(uint32_t));
+    first->label_operands = realloc(first->label_operands, (instructions_count + 1) * sizeof(uint8_t));
+
+    if (!first->instructions || !first->instruction_lines || !first->label_operands)
+    {
+        log_fatal("Could not allocate memory for the optimizer :(");
+        assert(0);
+    }
+
+    for (uint32_t i = 1; i < chunks_count; ++i)
+    {
+        mima_compile_chunk *chunk = &chunks[i];
+        memcpy(&first->instructions[chunk->address_base], chunk->instructions, chunk->instruction_count * sizeof(mima_word));
+        memcpy(&first->instruction_lines[chunk->address_base], chunk->instruction_lines, chunk->instruction_count * sizeof(uint32_t));
+        memcpy(&first->label_operands[chunk->address_base], chunk->label_operands, chunk->instruction_count * sizeof(uint8_t));
+        chunk->instruction_count = 0;
+    }
+
+    uint32_t *relocation = malloc((instructions_count + 1) * sizeof(uint32_t));
+
+    if (!relocation)
+    {
+        log_fatal("Could not allocate memory for the optimizer :(");
+        assert(0);
+    }
+
+    first->instruction_count = mima_optimize_code(first->instructions, first->instruction_lines, first->label_operands, instructions_count, relocation);
+
+    // jump tables of .word move along with the labels they point to
+    if (first->instruction_count < instructions_count)
+    {
+        for (uint32_t i = 0; i < chunks_count; ++i)
+        {
+            for (size_t j = 0; j < chunks[i].stores_count; ++j)
+            {
+                mima_deferred_store *store = &chunks[i].stores[j];
+
+                for (uint32_t k = 0; k < store->count && (store->label_words[0] | store->label_words[1]); ++k)
+                {
+                    if ((store->label_words[k >> 6] >> (k & 63)) & 1 && store->data[k] <= instructions_count)
+                    {
+                        store->data[k] = relocation[store->data[k]];
+                    }
+                }
+            }
+        }
+    }
+
+    free(relocation);
+
+    for (uint32_t i = 1; i < chunks_count; ++i)
+    {
+        chunks[i].address_base = first->instruction_count;
+    }
+
+    return first->instruction_count;
+}
+
+// Assembles the source into an image and, if a memory unit is given, emits it there.
+// Returns the number of errors.
+static size_t mima_assemble_buffer(const char *source, size_t size, uint32_t threads, mima_memory_unit *memory_unit, mima_image *image)
+{
+    mima_compile_chunk chunks[MIMA_PARALLEL_COMPILE_MAX_THREADS];
+    uint32_t chunks_count = 0;
+
+    // Split the source into line aligned chunks.
+    // Every chunk starts right after a newline, so the line splitting of "mima_next_line()" is the same as for the whole buffer.
+    threads = mima_compile_thread_count(size, threads);
+    const char *end = source + size;
+    const char *cursor = source;
+
+    // an empty source still gets one (empty) chunk
+    do
+    {
+        const char *chunk_end = cursor + size / threads;
+
+        if (chunks_count + 1 == threads || chunk_end >= end)
+        {
+            chunk_end = end;
+        }
+        else
+        {
+            const char *newline = memchr(chunk_end, '\n', end - chunk_end);
+            chunk_end = newline ? newline + 1 : end;
+        }
+
+        memset(&chunks[chunks_count], 0, sizeof(mima_compile_chunk));
+        chunks[chunks_count].begin = cursor;
+        chunks[chunks_count].end = chunk_end;
+        chunks[chunks_count].memory_unit = memory_unit;
+        chunks_count++;
+
+        cursor = chunk_end;
+    } while (cursor < end);
+
+    if (chunks_count > 1)
+    {
+        log_info("Assembling %u chunks in parallel ...", chunks_count);
+    }
+
+    // First, scan the chunks for labels.
+    // This two-pass approach allows us to use them without forward declaration.
+    mima_run_chunks(chunks, chunks_count, mima_scan_chunk_for_labels);
+
+    size_t line_base = 0;
+    size_t address_base = 0;
+    for (uint32_t i = 0; i < chunks_count; ++i)
+    {
+        mima_compile_chunk *chunk = &chunks[i];
+        chunk->line_base = line_base;
+        chunk->scan_address_base = address_base;
+
+        // labels are pushed in source order, so duplicates resolve the same way as before
+        for (uint32_t j = 0; j < chunk->labels_count; ++j)
+        {
+            mima_chunk_label *label = &chunk->labels[j];
+            uint32_t address = address_base + label->label.address;
+            log_trace("Line %03zu: %3s for address 0x%08x", line_base + label->line, label->label.label_name, address);
+            mima_push_label(label->label.label_name, address, line_base + label->line);
+        }
+
+        line_base += chunk->line_count;
+        address_base += chunk->scan_instruction_count;
+    }
+
+    log_trace("Found %u label(s) while scanning the input file.", labels_count);
+    mima_build_label_index();
+
+    // Second, assemble every chunk into its own buffer.
+    mima_run_chunks(chunks, chunks_count, mima_assemble_chunk);
+
+    // Instructions that failed to assemble do not occupy an address,
+    // so the final addresses are fixed up with a prefix sum over the assembled instructions.
+    size_t error = 0;
+    address_base = 0;
+    for (uint32_t i = 0; i < chunks_count; ++i)
+    {
+        chunks[i].address_base = address_base;
+        address_base += chunks[i].instruction_count;
+        error += chunks[i].error;
+    }
+
+    if (mima_optimize && address_base > 0)
+    {
+        address_base = mima_optimize_chunks(chunks, chunks_count, address_base);
+    }
+
+    if (memory_unit)
+    {
+        mima_run_chunks(chunks, chunks_count, mima_emit_chunk);
+        mima_memory_mark_dirty_range(memory_unit, 0, address_base);
+    }
+
+    // Storage definitions are applied in source order.
+    // An instruction assembled after a definition overwrites it, just like a sequential pass would do.
+    size_t instructions_count = address_base;
+    size_t stores_count = 0;
+    for (uint32_t i = 0; i < chunks_count; ++i)
+    {
+        for (size_t j = 0; j < chunks[i].stores_count; ++j)
+        {
+            stores_count += chunks[i].stores[j].count;
+        }
+    }
+
+    mima_sorted_store *stores = malloc((stores_count + 1) * sizeof(mima_sorted_store));
+    mima_image_entry *entries = malloc((instructions_count + stores_count + 1) * sizeof(mima_image_entry));
+
+    if (!stores || !entries)
+    {
+        log_fatal("Could not allocate memory for the assembled image :(");
+        assert(0);
+    }
+
+    stores_count = 0;
+    size_t entries_count = 0;
+    for (uint32_t i = 0; i < chunks_count; ++i)
+    {
+        mima_compile_chunk *chunk = &chunks[i];
+
+        for (size_t j = 0; j < chunk->instruction_count; ++j)
+        {
+            entries[entries_count].address = chunk->address_base + j;
+            entries[entries_count].word = chunk->instructions[j];
+            mima_source_position(chunk->instruction_lines[j], &entries[entries_count].file, &entries[entries_count].line);
+            entries_count++;
+        }
+
+        for (size_t j = 0; j < chunk->stores_count; ++j)
+        {
+            mima_deferred_store *store = &chunk->stores[j];
+            size_t position = chunk->address_base + store->position;
+            size_t begin = store->address;
+            size_t end = begin + store->count;
+
+            // words in [position, instructions_count) are overwritten by the instructions that follow,
+            // which leaves up to two parts of the block in front of and behind them
+            size_t parts[2][2] = { { begin, end < position ? end : position }, { begin > instructions_count ? begin : instructions_count, end } };
+            uint32_t file;
+            uint32_t line;
+            mima_source_position(store->line, &file, &line);
+
+            for (int k = 0; k < 2; ++k)
+            {
+                if (parts[k][0] >= parts[k][1])
+                {
+                    continue;
+                }
+
+                size_t offset = parts[k][0] - begin;
+                uint32_t count = parts[k][1] - parts[k][0];
+
+                if (memory_unit)
+                {
+                    if (store->data)
+                    {
+                        mima_memory_write_block(memory_unit, parts[k][0], &store->data[offset], count);
+                    }
+                    else
+                    {
+                        mima_memory_fill(memory_unit, parts[k][0], count, store->value);
+                    }
+                }
+
+                for (uint32_t l = 0; l < count; ++l)
+                {
+                    stores[stores_count].entry.address = parts[k][0] + l;
+                    stores[stores_count].entry.word = store->data ? store->data[offset + l] : store->value;
+                    stores[stores_count].entry.file = file;
+                    stores[stores_count].entry.line = line;
+                    stores[stores_count].sequence = stores_count;
+                    stores_count++;
+                }
+            }
+
+            free(store->data);
+        }
+
+        free(chunk->labels);
+        free(chunk->instructions);
+        free(chunk->instruction_lines);
+        free(chunk->label_operands);
+        free(chunk->stores);
+    }
+
+    // Storage definitions only reach the image where they survived, so they win over instructions at the same address.
+    // Data blocks are usually defined in address order, the sort is skipped for them.
+    size_t sorted = 1;
+    while (sorted < stores_count && stores[sorted - 1].entry.address <= stores[sorted].entry.address)
+    {
+        sorted++;
+    }
+
+    if (sorted < stores_count)
+    {
+        qsort(stores, stores_count, sizeof(mima_sorted_store), mima_compare_sorted_stores);
+    }
+
+    image->entries = malloc((entries_count + stores_count + 1) * sizeof(mima_image_entry));
+
+    if (!image->entries)
+    {
+        log_fatal("Could not allocate memory for the assembled image :(");
+        assert(0);
+    }
+
+    size_t instruction = 0;
+    size_t store = 0;
+    image->count = 0;
+    image->instructions_count = instructions_count;
+    while (instruction < entries_count || store < stores_count)
+    {
+        if (store < stores_count)
+        {
+            // only the last definition of an address counts
+            while (store + 1 < stores_count && stores[store + 1].entry.address == stores[store].entry.address)
+            {
+                store++;
+            }
+
+            if (instruction >= entries_count || stores[store].entry.address <= entries[instruction].address)
+            {
+                if (instruction < entries_count && stores[store].entry.address == entries[instruction].address)
+                {
+                    instruction++;
+                }
+
+                image->entries[image->count++] = stores[store++].entry;
+                continue;
+            }
+        }
+
+        image->entries[image->count++] = entries[instruction++];
+    }
+
+    free(stores);
+    free(entries);
+
+    return error;
+}
+
+mima_bool mima_compile_buffer(mima_t *mima, const char *source, size_t size, uint32_t threads)
+{
+    mima_image_free(&mima_assembled_image);
+    size_t error = mima_assemble_buffer(source, size, threads, &mima->memory_unit, &mima_assembled_image);
+
     if (error > 0)
     {
-        log_error("Found %d error(s) or warning(s) while compiling.", error);
+        log_error("Found %zu error(s) or warning(s) while compiling.", error);
         log_error("Setting mima RUN flag to false.");
         log_error("Nothing will be executed...");
         mima->control_unit.RUN = mima_false;
+        mima->stop_reason = MIMA_STOP_ERROR;
     }
     else
     {
@@ -297,6 +1345,241 @@ mima_bool mima_compile_file(mima_t *mima, const char *file_name)
     return mima_true;
 }
 
+static mima_bool mima_map_source(const char *file_name, const char **source, size_t *size)
+{
+    int file = open(file_name, O_RDONLY);
+
+    if (file < 0)
+    {
+        log_error("Failed to open source code file: %s :(", file_name);
+        return mima_false;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(file, &file_stat) != 0)
+    {
+        log_error("Failed to stat source code file: %s :(", file_name);
+        close(file);
+        return mima_false;
+    }
+
+    *size = file_stat.st_size;
+    *source = NULL;
+
+    if (*size > 0)
+    {
+        *source = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, file, 0);
+
+        if (*source == MAP_FAILED)
+        {
+            log_error("Failed to map source code file: %s :(", file_name);
+            close(file);
+            return mima_false;
+        }
+    }
+
+    close(file);
+    return mima_true;
+}
+
+static void mima_unmap_source(const char *source, size_t size)
+{
+    if (source)
+    {
+        munmap((void *)source, size);
+    }
+}
+
+// Maps the source and expands its directives.
+// *expanded has to be freed and *source unmapped afterwards, the text to assemble is *expanded if set, else *source.
+static mima_bool mima_load_source(const char *file_name, const char **source, size_t *size, char **expanded, size_t *expanded_size)
+{
+    if (!mima_map_source(file_name, source, size))
+    {
+        return mima_false;
+    }
+
+    if (!mima_preprocess_source(file_name, *source, *size, expanded, expanded_size))
+    {
+        mima_unmap_source(*source, *size);
+        return mima_false;
+    }
+
+    return mima_true;
+}
+
+mima_bool mima_compile_file(mima_t *mima, const char *file_name)
+{
+    const char *source;
+    size_t size;
+    char *expanded;
+    size_t expanded_size;
+
+    if (!mima_load_source(file_name, &source, &size, &expanded, &expanded_size))
+    {
+        return mima_false;
+    }
+
+    log_info("Compiling %s ...", file_name);
+    assemble_file_name = file_name;
+    mima_source_map_free(&source_map);
+
+    if (expanded)
+    {
+        mima_source_map_build(&source_map, expanded, expanded_size);
+    }
+
+    mima_bool result = expanded ? mima_compile_buffer(mima, expanded, expanded_size, 0) : mima_compile_buffer(mima, source, size, 0);
+    mima_unmap_source(source, size);
+    free(expanded);
+    assemble_file_name = NULL;
+
+    strncpy(source_file_name, file_name, sizeof(source_file_name) - 1);
+
+    return result;
+}
+
+mima_bool mima_reassemble_file(mima_t *mima, const char *file_name)
+{
+    if (file_name == NULL || file_name[0] == 0)
+    {
+        file_name = source_file_name;
+    }
+
+    if (file_name[0] == 0)
+    {
+        log_error("There is no source code file to reassemble.");
+        return mima_false;
+    }
+
+    const char *source;
+    size_t size;
+    char *expanded;
+    size_t expanded_size;
+
+    if (!mima_load_source(file_name, &source, &size, &expanded, &expanded_size))
+    {
+        return mima_false;
+    }
+
+    log_info("Reassembling %s ...", file_name);
+
+    // keep the old labels in case the new source does not assemble
+    uint32_t old_labels_count = labels_count;
+    mima_label *old_labels = malloc((old_labels_count + 1) * sizeof(mima_label));
+
+    if (!old_labels)
+    {
+        log_error("Could not allocate memory for labels.");
+        mima_unmap_source(source, size);
+        free(expanded);
+        return mima_false;
+    }
+
+    memcpy(old_labels, mima_labels, old_labels_count * sizeof(mima_label));
+    labels_count = 0;
+
+    // the old image keeps its source map until the new one is taken
+    mima_source_map old_source_map = source_map;
+    memset(&source_map, 0, sizeof(mima_source_map));
+
+    if (expanded)
+    {
+        mima_source_map_build(&source_map, expanded, expanded_size);
+    }
+
+    mima_image image = {0};
+    assemble_file_name = file_name;
+    size_t error = expanded ? mima_assemble_buffer(expanded, expanded_size, 0, NULL, &image) : mima_assemble_buffer(source, size, 0, NULL, &image);
+    mima_unmap_source(source, size);
+    free(expanded);
+    assemble_file_name = NULL;
+
+    if (error > 0)
+    {
+        log_error("Found %zu error(s) or warning(s) while reassembling, memory is left untouched.", error);
+
+        // labels_capacity never shrinks, so the old labels still fit
+        memcpy(mima_labels, old_labels, old_labels_count * sizeof(mima_label));
+        labels_count = old_labels_count;
+        mima_build_label_index();
+
+        free(old_labels);
+        mima_image_free(&image);
+        mima_source_map_free(&source_map);
+        source_map = old_source_map;
+        return mima_false;
+    }
+
+    free(old_labels);
+    mima_source_map_free(&old_source_map);
+
+    // Walk both images by address and only touch the words that differ.
+    // Registers and words that did not change in the source (e.g. data modified by the running program) are kept.
+    mima_image *old_image = &mima_assembled_image;
+    mima_memory_unit *memory_unit = &mima->memory_unit;
+    size_t changed = 0;
+    size_t added = 0;
+    size_t removed = 0;
+    size_t old_index = 0;
+    size_t new_index = 0;
+    while (old_index < old_image->count || new_index < image.count)
+    {
+        mima_image_entry *old_entry = old_index < old_image->count ? &old_image->entries[old_index] : NULL;
+        mima_image_entry *new_entry = new_index < image.count ? &image.entries[new_index] : NULL;
+
+        if (old_entry && (!new_entry || old_entry->address < new_entry->address))
+        {
+            // no longer assembled -> back to the initial zero
+            log_trace("Line ---: mem[0x%08x] = 0x%08x -> removed", old_entry->address, old_entry->word);
+            mima_memory_write(memory_unit, old_entry->address, 0);
+            removed++;
+            old_index++;
+            continue;
+        }
+
+        if (!old_entry || new_entry->address < old_entry->address)
+        {
+            log_trace("%s: mem[0x%08x] = 0x%08x -> added", mima_source_location(new_entry->file, new_entry->line), new_entry->address, new_entry->word);
+            mima_memory_write(memory_unit, new_entry->address, new_entry->word);
+            added++;
+            new_index++;
+            continue;
+        }
+
+        if (old_entry->word != new_entry->word)
+        {
+            log_trace("%s: mem[0x%08x] = 0x%08x -> 0x%08x", mima_source_location(new_entry->file, new_entry->line), new_entry->address, old_entry->word, new_entry->word);
+            mima_memory_write(memory_unit, new_entry->address, new_entry->word);
+            changed++;
+        }
+
+        old_index++;
+        new_index++;
+    }
+
+    mima_image_free(&mima_assembled_image);
+    mima_assembled_image = image;
+
+    if (file_name != source_file_name)
+    {
+        snprintf(source_file_name, sizeof(source_file_name), "%s", file_name);
+    }
+
+    log_info("Reassembled %s: %zu word(s) changed, %zu added, %zu removed.", file_name, changed, added, removed);
+
+    return mima_true;
+}
+
+void mima_image_free(mima_image *image)
+{
+    free(image->entries);
+    image->entries = NULL;
+    image->count = 0;
+    image->instructions_count = 0;
+}
+
 void mima_push_label(const char *label_name, uint32_t address, size_t line)
 {
     if (labels_count + 1 > labels_capacity)
@@ -306,34 +1589,63 @@ void mima_push_label(const char *label_name, uint32_t address, size_t line)
 
         if (!mima_labels)
         {
-            log_error("Line %03zu: Could not realloc memory for labels.", line);
+            log_error("%s: Could not realloc memory for labels.", mima_assembled_location(line));
         }
     }
 
     if (strlen(label_name) > 31)
     {
-        log_error("Line %03zu: Label size is limited by 32 chars.", line);
+        log_error("%s: Label size is limited by 32 chars.", mima_assembled_location(line));
     }
 
     strncpy(mima_labels[labels_count].label_name, label_name, 31);
+    mima_labels[labels_count].label_name[31] = 0;
     mima_labels[labels_count].address = address;
 
     labels_count++;
+    label_index_count = 0;
 }
 
 uint32_t mima_address_for_label(const char *label_name, size_t line)
 {
-    for (int i = 0; i < labels_count; ++i)
+    if (label_index_count == labels_count)
     {
-        log_trace("Line %03zu: Searching for Label %s == %s", line, label_name, mima_labels[i].label_name);
+        // binary search for the first declaration of the label
+        uint32_t low = 0;
+        uint32_t high = label_index_count;
+        while (low < high)
+        {
+            uint32_t middle = low + (high - low) / 2;
 
-        if (strcmp(mima_labels[i].label_name, label_name) == 0)
+            if (strcmp(mima_labels[label_index[middle]].label_name, label_name) < 0)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        if (low < label_index_count && strcmp(mima_labels[label_index[low]].label_name, label_name) == 0)
         {
-            return mima_labels[i].address;
+            return mima_labels[label_index[low]].address;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < labels_count; ++i)
+        {
+            log_trace("Line %03zu: Searching for Label %s == %s", line, label_name, mima_labels[i].label_name);
+
+            if (strcmp(mima_labels[i].label_name, label_name) == 0)
+            {
+                return mima_labels[i].address;
+            }
         }
     }
 
-    log_error("Line %03zu: Could not find your label: %s", line, label_name);
+    log_error("%s: Could not find your label: %s", mima_assembled_location(line), label_name);
     return -1;
 }
 
@@ -341,7 +1653,14 @@ mima_bool mima_assemble_instruction(mima_register *instruction, uint32_t op_code
 {
     if (op_code < 0 || op_code > 0xFF)
     {
-        log_error("Line %03zu: Invalid op code %d", line, op_code);
+        log_error("%s: Invalid op code %d", mima_assembled_location(line), op_code);
+        return mima_false;
+    }
+
+    // the extended ISA only has 24 bits for addresses
+    if (op_code >= MUL && value > 0x00FFFFFF)
+    {
+        log_error("%s: %s only reaches addresses up to 0x00FFFFFF", mima_assembled_location(line), mima_get_instruction_name(op_code));
         return mima_false;
     }
 
@@ -354,7 +1673,7 @@ mima_bool mima_assemble_instruction(mima_register *instruction, uint32_t op_code
 
     if (value < 0 || value > 0x0FFFFFFF)
     {
-        log_error("Line %03zu: Invalid value %d", line, op_code);
+        log_error("%s: Invalid value %d", mima_assembled_location(line), op_code);
         return mima_false;
     }
 
@@ -0,0 +1,770 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "mima_debug_server.h"
+#include "mima_memory.h"
+#include "log.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define MIMA_DEBUG_MAX_CLIENTS  32
+#define MIMA_DEBUG_INPUT_SIZE   (64 * 1024)
+#define MIMA_DEBUG_MAX_WORDS    4096    // per memory packet
+#define MIMA_DEBUG_RUN_SLICE    4096    // instructions between two polls while running
+#define MIMA_DEBUG_REGISTERS    11
+
+typedef struct _mima_debug_client
+{
+    int fd;
+    mima_bool closing;
+    char input[MIMA_DEBUG_INPUT_SIZE];
+    size_t input_used;
+    char *output;
+    size_t output_used;
+    size_t output_capacity;
+} mima_debug_client;
+
+typedef struct _mima_debug_server
+{
+    mima_t *mima;
+    int listen_fd;
+    const char *unix_path;
+
+    mima_debug_client *clients[MIMA_DEBUG_MAX_CLIENTS];
+    uint32_t clients_count;
+
+    mima_register *breakpoints;     // sorted
+    uint32_t breakpoints_count;
+    uint32_t breakpoints_capacity;
+
+    mima_debug_client *running;     // client waiting for the stop reply of "c", NULL if stopped
+    mima_bool skip_breakpoint;      // the first instruction of "c" may sit on a breakpoint
+    const char *stop_reason;
+    mima_bool quit;
+} mima_debug_server;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static void mima_debug_set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int mima_debug_listen(const char *endpoint, const char **unix_path)
+{
+    char *endptr;
+    long port = strtol(endpoint, &endptr, 10);
+    int fd;
+
+    *unix_path = NULL;
+
+    if (*endpoint != 0 && *endptr == 0)
+    {
+        // only a number -> TCP port on localhost
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((uint16_t)port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (fd < 0)
+        {
+            return -1;
+        }
+
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+
+        if (strlen(endpoint) >= sizeof(address.sun_path))
+        {
+            return -1;
+        }
+
+        strcpy(address.sun_path, endpoint);
+        unlink(endpoint);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (fd < 0)
+        {
+            return -1;
+        }
+
+        if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+
+        *unix_path = endpoint;
+    }
+
+    if (listen(fd, MIMA_DEBUG_MAX_CLIENTS) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    mima_debug_set_nonblocking(fd);
+    return fd;
+}
+
+static void mima_debug_flush(mima_debug_client *client)
+{
+    while (client->output_used > 0)
+    {
+        ssize_t written = send(client->fd, client->output, client->output_used, MSG_NOSIGNAL);
+
+        if (written <= 0)
+        {
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                // poll() tells us when we can continue
+                return;
+            }
+
+            client->closing = mima_true;
+            client->output_used = 0;
+            return;
+        }
+
+        memmove(client->output, client->output + written, client->output_used - written);
+        client->output_used -= written;
+    }
+}
+
+static void mima_debug_write(mima_debug_client *client, const char *data, size_t size)
+{
+    if (client->output_used + size > client->output_capacity)
+    {
+        size_t capacity = client->output_capacity ? client->output_capacity : 4096;
+
+        while (capacity < client->output_used + size)
+        {
+            capacity *= 2;
+        }
+
+        char *output = realloc(client->output, capacity);
+
+        if (!output)
+        {
+            log_error("Could not allocate memory for a debug client, dropping it.");
+            client->closing = mima_true;
+            return;
+        }
+
+        client->output = output;
+        client->output_capacity = capacity;
+    }
+
+    memcpy(client->output + client->output_used, data, size);
+    client->output_used += size;
+}
+
+static void mima_debug_send_packet(mima_debug_client *client, const char *data, size_t size)
+{
+    uint8_t checksum = 0;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        checksum += (uint8_t)data[i];
+    }
+
+    char trailer[3] = { '#', hex_digits[checksum >> 4], hex_digits[checksum & 0xF] };
+
+    mima_debug_write(client, "$", 1);
+    mima_debug_write(client, data, size);
+    mima_debug_write(client, trailer, sizeof(trailer));
+    mima_debug_flush(client);
+}
+
+static void mima_debug_send_string(mima_debug_client *client, const char *string)
+{
+    mima_debug_send_packet(client, string, strlen(string));
+}
+
+static char *mima_debug_put_hex(char *out, uint32_t value)
+{
+    for (int i = 7; i >= 0; --i)
+    {
+        out[i] = hex_digits[value & 0xF];
+        value >>= 4;
+    }
+
+    return out + 8;
+}
+
+static mima_register *mima_debug_register(mima_t *mima, uint32_t number)
+{
+    switch (number)
+    {
+    case 0:
+        return &mima->processing_unit.ACC;
+    case 1:
+        return &mima->control_unit.IAR;
+    case 2:
+        return &mima->control_unit.IR;
+    case 3:
+        return &mima->memory_unit.SAR;
+    case 4:
+        return &mima->memory_unit.SIR;
+    case 5:
+        return &mima->processing_unit.X;
+    case 6:
+        return &mima->processing_unit.Y;
+    case 7:
+        return &mima->processing_unit.Z;
+    case 10:
+        return &mima->control_unit.SP;
+    default:
+        return NULL;
+    }
+}
+
+static uint32_t mima_debug_read_register(mima_t *mima, uint32_t number)
+{
+    mima_register *reg = mima_debug_register(mima, number);
+
+    if (reg)
+    {
+        return *reg;
+    }
+
+    return number == 8 ? mima->processing_unit.MICRO_CYCLE : mima->control_unit.RUN;
+}
+
+static uint32_t mima_debug_find_breakpoint(mima_debug_server *server, mima_register address)
+{
+    uint32_t low = 0;
+    uint32_t high = server->breakpoints_count;
+
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (server->breakpoints[middle] < address)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static mima_bool mima_debug_has_breakpoint(mima_debug_server *server, mima_register address)
+{
+    if (server->breakpoints_count == 0)
+    {
+        return mima_false;
+    }
+
+    uint32_t index = mima_debug_find_breakpoint(server, address);
+    return index < server->breakpoints_count && server->breakpoints[index] == address;
+}
+
+static mima_bool mima_debug_insert_breakpoint(mima_debug_server *server, mima_register address)
+{
+    uint32_t index = mima_debug_find_breakpoint(server, address);
+
+    if (index < server->breakpoints_count && server->breakpoints[index] == address)
+    {
+        return mima_true;
+    }
+
+    if (server->breakpoints_count + 1 > server->breakpoints_capacity)
+    {
+        uint32_t capacity = server->breakpoints_capacity ? server->breakpoints_capacity * 2 : 16;
+        mima_register *breakpoints = realloc(server->breakpoints, capacity * sizeof(mima_register));
+
+        if (!breakpoints)
+        {
+            return mima_false;
+        }
+
+        server->breakpoints = breakpoints;
+        server->breakpoints_capacity = capacity;
+    }
+
+    memmove(&server->breakpoints[index + 1], &server->breakpoints[index], (server->breakpoints_count - index) * sizeof(mima_register));
+    server->breakpoints[index] = address;
+    server->breakpoints_count++;
+
+    return mima_true;
+}
+
+static void mima_debug_remove_breakpoint(mima_debug_server *server, mima_register address)
+{
+    uint32_t index = mima_debug_find_breakpoint(server, address);
+
+    if (index < server->breakpoints_count && server->breakpoints[index] == address)
+    {
+        memmove(&server->breakpoints[index], &server->breakpoints[index + 1], (server->breakpoints_count - index - 1) * sizeof(mima_register));
+        server->breakpoints_count--;
+    }
+}
+
+// Finishes the current instruction (or executes the next one).
+static void mima_debug_step(mima_t *mima)
+{
+    mima->control_unit.RUN = mima_true;
+    mima_execute_instruction(mima);
+}
+
+static const char *mima_debug_stop_reason(mima_t *mima)
+{
+    return mima->control_unit.RUN ? "S05" : "W00";
+}
+
+static void mima_debug_stop(mima_debug_server *server, const char *reason)
+{
+    server->stop_reason = reason;
+
+    if (server->running)
+    {
+        mima_debug_send_string(server->running, reason);
+        server->running = NULL;
+    }
+}
+
+// Runs one slice of "c", the event loop polls the clients in between.
+static void mima_debug_run_slice(mima_debug_server *server)
+{
+    mima_t *mima = server->mima;
+
+    for (uint32_t i = 0; i < MIMA_DEBUG_RUN_SLICE; ++i)
+    {
+        if (!server->skip_breakpoint && mima_debug_has_breakpoint(server, mima->control_unit.IAR))
+        {
+            mima_debug_stop(server, "S05");
+            return;
+        }
+
+        server->skip_breakpoint = mima_false;
+        mima_debug_step(mima);
+
+        if (!mima->control_unit.RUN)
+        {
+            mima_debug_stop(server, "W00");
+            return;
+        }
+    }
+}
+
+static void mima_debug_handle_packet(mima_debug_server *server, mima_debug_client *client, char *packet)
+{
+    mima_t *mima = server->mima;
+    static char reply[MIMA_DEBUG_MAX_WORDS * 8 + 1];
+    char *endptr;
+
+    switch (packet[0])
+    {
+    case '?':
+        mima_debug_send_string(client, server->stop_reason);
+        break;
+    case 'g':
+    {
+        char *out = reply;
+
+        for (uint32_t i = 0; i < MIMA_DEBUG_REGISTERS; ++i)
+        {
+            out = mima_debug_put_hex(out, mima_debug_read_register(mima, i));
+        }
+
+        mima_debug_send_packet(client, reply, out - reply);
+        break;
+    }
+    case 'p':
+    {
+        uint32_t number = strtoul(packet + 1, &endptr, 16);
+
+        if (number >= MIMA_DEBUG_REGISTERS)
+        {
+            mima_debug_send_string(client, "E01");
+            break;
+        }
+
+        mima_debug_send_packet(client, reply, mima_debug_put_hex(reply, mima_debug_read_register(mima, number)) - reply);
+        break;
+    }
+    case 'P':
+    {
+        uint32_t number = strtoul(packet + 1, &endptr, 16);
+        mima_register *reg = mima_debug_register(mima, number);
+
+        if (!reg || *endptr != '=')
+        {
+            mima_debug_send_string(client, "E01");
+            break;
+        }
+
+        *reg = strtoul(endptr + 1, NULL, 16);
+        mima_debug_send_string(client, "OK");
+        break;
+    }
+    case 'm':
+    case 'M':
+    {
+        mima_register address = strtoul(packet + 1, &endptr, 16);
+        uint32_t count = *endptr == ',' ? strtoul(endptr + 1, &endptr, 16) : 0;
+
+        if (count > MIMA_DEBUG_MAX_WORDS || address >= mima_words || count > mima_words - address)
+        {
+            mima_debug_send_string(client, "E02");
+            break;
+        }
+
+        if (packet[0] == 'm')
+        {
+            char *out = reply;
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                out = mima_debug_put_hex(out, mima->memory_unit.memory[address + i]);
+            }
+
+            mima_debug_send_packet(client, reply, out - reply);
+            break;
+        }
+
+        if (*endptr != ':' || strlen(endptr + 1) != count * 8)
+        {
+            mima_debug_send_string(client, "E03");
+            break;
+        }
+
+        char word[9] = {0};
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            memcpy(word, endptr + 1 + i * 8, 8);
+            mima_memory_write(&mima->memory_unit, address + i, strtoul(word, NULL, 16));
+        }
+
+        mima_debug_send_string(client, "OK");
+        break;
+    }
+    case 's':
+        // the machine belongs to the client that continued it until it stops
+        if (server->running)
+        {
+            mima_debug_send_string(client, "E05");
+            break;
+        }
+
+        mima_debug_step(mima);
+        server->stop_reason = mima_debug_stop_reason(mima);
+        mima_debug_send_string(client, server->stop_reason);
+        break;
+    case 'c':
+        if (server->running && server->running != client)
+        {
+            mima_debug_send_string(client, "E05");
+            break;
+        }
+
+        // the reply is sent once the machine stops
+        mima->control_unit.RUN = mima_true;
+        server->running = client;
+        server->skip_breakpoint = mima_true;
+        break;
+    case 'Z':
+    case 'z':
+    {
+        if (packet[1] != '0' || packet[2] != ',')
+        {
+            // only software breakpoints are supported
+            mima_debug_send_string(client, "");
+            break;
+        }
+
+        mima_register address = strtoul(packet + 3, NULL, 16);
+
+        if (packet[0] == 'z')
+        {
+            mima_debug_remove_breakpoint(server, address);
+        }
+        else if (!mima_debug_insert_breakpoint(server, address))
+        {
+            mima_debug_send_string(client, "E04");
+            break;
+        }
+
+        mima_debug_send_string(client, "OK");
+        break;
+    }
+    case 'D':
+        mima_debug_send_string(client, "OK");
+        client->closing = mima_true;
+        break;
+    case 'k':
+        server->quit = mima_true;
+        break;
+    default:
+        // unsupported -> empty reply
+        mima_debug_send_string(client, "");
+        break;
+    }
+}
+
+static void mima_debug_handle_input(mima_debug_server *server, mima_debug_client *client)
+{
+    char *input = client->input;
+    size_t used = client->input_used;
+    size_t position = 0;
+
+    while (position < used)
+    {
+        char c = input[position];
+
+        if (c == 0x03)
+        {
+            // interrupt a running machine
+            if (server->running)
+            {
+                mima_debug_stop(server, "S02");
+            }
+
+            position++;
+            continue;
+        }
+
+        if (c != '$')
+        {
+            // acknowledgements and noise
+            position++;
+            continue;
+        }
+
+        char *hash = memchr(input + position, '#', used - position);
+
+        if (!hash || hash + 2 >= input + used)
+        {
+            // incomplete packet, wait for more data
+            break;
+        }
+
+        char *packet = input + position + 1;
+        uint8_t checksum = 0;
+
+        for (char *p = packet; p < hash; ++p)
+        {
+            checksum += (uint8_t)*p;
+        }
+
+        char expected[3] = { hash[1], hash[2], 0 };
+        position = hash + 3 - input;
+
+        if (strtoul(expected, NULL, 16) != checksum)
+        {
+            mima_debug_write(client, "-", 1);
+            continue;
+        }
+
+        mima_debug_write(client, "+", 1);
+
+        *hash = 0;
+        mima_debug_handle_packet(server, client, packet);
+    }
+
+    memmove(input, input + position, used - position);
+    client->input_used = used - position;
+
+    if (client->input_used == MIMA_DEBUG_INPUT_SIZE)
+    {
+        log_warn("Debug client sent an oversized packet, dropping it.");
+        client->closing = mima_true;
+    }
+
+    mima_debug_flush(client);
+}
+
+static void mima_debug_accept(mima_debug_server *server)
+{
+    int fd;
+
+    while ((fd = accept(server->listen_fd, NULL, NULL)) >= 0)
+    {
+        if (server->clients_count == MIMA_DEBUG_MAX_CLIENTS)
+        {
+            log_warn("Too many debug clients, rejecting a connection.");
+            close(fd);
+            continue;
+        }
+
+        mima_debug_client *client = calloc(1, sizeof(mima_debug_client));
+
+        if (!client)
+        {
+            close(fd);
+            continue;
+        }
+
+        mima_debug_set_nonblocking(fd);
+        client->fd = fd;
+        server->clients[server->clients_count++] = client;
+        log_info("Debug client connected (%u connected).", server->clients_count);
+    }
+}
+
+static void mima_debug_close(mima_debug_server *server, uint32_t index)
+{
+    mima_debug_client *client = server->clients[index];
+
+    if (server->running == client)
+    {
+        // nobody is waiting for the result anymore
+        server->running = NULL;
+        server->stop_reason = "S02";
+    }
+
+    close(client->fd);
+    free(client->output);
+    free(client);
+
+    server->clients[index] = server->clients[--server->clients_count];
+    log_info("Debug client disconnected (%u connected).", server->clients_count);
+}
+
+mima_bool mima_debug_server_run(mima_t *mima, const char *endpoint)
+{
+    mima_debug_server server;
+    memset(&server, 0, sizeof(server));
+    server.mima = mima;
+    server.stop_reason = mima_debug_stop_reason(mima);
+    server.listen_fd = mima_debug_listen(endpoint, &server.unix_path);
+
+    if (server.listen_fd < 0)
+    {
+        log_error("Could not listen on %s: %s", endpoint, strerror(errno));
+        return mima_false;
+    }
+
+    log_info("Debug server listening on %s", endpoint);
+
+    struct pollfd fds[MIMA_DEBUG_MAX_CLIENTS + 1];
+    while (!server.quit)
+    {
+        fds[0].fd = server.listen_fd;
+        fds[0].events = POLLIN;
+
+        for (uint32_t i = 0; i < server.clients_count; ++i)
+        {
+            fds[i + 1].fd = server.clients[i]->fd;
+            fds[i + 1].events = POLLIN | (server.clients[i]->output_used > 0 ? POLLOUT : 0);
+            fds[i + 1].revents = 0;
+        }
+
+        // do not wait while the machine is running
+        int ready = poll(fds, server.clients_count + 1, server.running ? 0 : -1);
+
+        if (ready < 0 && errno != EINTR)
+        {
+            log_error("Debug server poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (ready > 0)
+        {
+            // only the clients that were polled, accept() may add more
+            uint32_t polled = server.clients_count;
+
+            if (fds[0].revents & POLLIN)
+            {
+                mima_debug_accept(&server);
+            }
+
+            for (uint32_t i = 0; i < polled; ++i)
+            {
+                mima_debug_client *client = server.clients[i];
+
+                if (fds[i + 1].fd != client->fd)
+                {
+                    continue;
+                }
+
+                if (fds[i + 1].revents & POLLOUT)
+                {
+                    mima_debug_flush(client);
+                }
+
+                if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+                {
+                    ssize_t received = recv(client->fd, client->input + client->input_used, MIMA_DEBUG_INPUT_SIZE - client->input_used, 0);
+
+                    if (received <= 0)
+                    {
+                        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                        {
+                            client->closing = mima_true;
+                        }
+                    }
+                    else
+                    {
+                        client->input_used += received;
+                        mima_debug_handle_input(&server, client);
+                    }
+                }
+            }
+        }
+
+        for (uint32_t i = server.clients_count; i-- > 0;)
+        {
+            if (server.clients[i]->closing && server.clients[i]->output_used == 0)
+            {
+                mima_debug_close(&server, i);
+            }
+        }
+
+        if (server.running)
+        {
+            mima_debug_run_slice(&server);
+        }
+    }
+
+    while (server.clients_count > 0)
+    {
+        mima_debug_flush(server.clients[0]);
+        mima_debug_close(&server, 0);
+    }
+
+    close(server.listen_fd);
+
+    if (server.unix_path)
+    {
+        unlink(server.unix_path);
+    }
+
+    free(server.breakpoints);
+    log_info("Debug server stopped.");
+
+    return mima_true;
+}
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mima_devices.h"
+#include "mima_memory.h"
+#include "log.h"
+
+mima_bool mima_device_map_file(mima_t *mima, const char *file_name, mima_register address, uint32_t max_words)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t offset = (size_t)address * sizeof(mima_word);
+
+    if (address >= mima_words || offset % page_size != 0)
+    {
+        log_error("Cannot map %s to 0x%08x, the address must be aligned to %ld words.", file_name, address, page_size / (long)sizeof(mima_word));
+        return mima_false;
+    }
+
+    int file = open(file_name, O_RDONLY);
+
+    if (file < 0)
+    {
+        log_error("Failed to open %s :(", file_name);
+        return mima_false;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(file, &file_stat) != 0)
+    {
+        log_error("Failed to stat %s :(", file_name);
+        close(file);
+        return mima_false;
+    }
+
+    size_t words = (file_stat.st_size + sizeof(mima_word) - 1) / sizeof(mima_word);
+    size_t window = mima_words - address;
+
+    if (max_words != 0 && max_words < window)
+    {
+        window = max_words;
+    }
+
+    mima_bool truncated = words > window;
+
+    if (truncated)
+    {
+        log_warn("%s has %zu words, only the first %zu are mapped.", file_name, words, window);
+        words = window;
+    }
+
+    if (words == 0)
+    {
+        log_warn("%s is empty, nothing to map.", file_name);
+        close(file);
+        return mima_true;
+    }
+
+    // Only the whole host pages of the window are mapped, the words of the last partial page are copied.
+    // Mapping that page as well would replace the program and data words behind the window.
+    size_t bytes = (words * sizeof(mima_word) / page_size) * page_size;
+    size_t tail_words = words - bytes / sizeof(mima_word);
+
+    // memdiff and pending checkpoints need the old content of every page that changes
+    mima_register last = address + words - 1;
+
+    for (uint32_t page = mima_page_of(address); page <= mima_page_of(last); ++page)
+    {
+        mima_memory_prepare_page(&mima->memory_unit, page);
+    }
+
+    if (bytes > 0)
+    {
+        void *target = (char *)mima->memory_unit.memory + offset;
+        void *mapped = mmap(target, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, file, 0);
+
+        if (mapped == MAP_FAILED)
+        {
+            log_error("Failed to map %s into guest memory :(", file_name);
+            close(file);
+            return mima_false;
+        }
+    }
+
+    if (tail_words > 0)
+    {
+        // the last word of the file may be incomplete, it is padded with zeros
+        mima_word *tail = calloc(tail_words, sizeof(mima_word));
+
+        if (!tail || pread(file, tail, tail_words * sizeof(mima_word), bytes) < 0)
+        {
+            log_error("Failed to read the end of %s :(", file_name);
+            free(tail);
+            close(file);
+            return mima_false;
+        }
+
+        mima_memory_write_block(&mima->memory_unit, address + bytes / sizeof(mima_word), tail, tail_words);
+        free(tail);
+    }
+
+    close(file);
+
+    log_info("Mapped %s to mem[0x%08x - 0x%08x] (%zu words).", file_name, address, (uint32_t)(address + words - 1), words);
+
+    return mima_true;
+}
+
+void mima_device_dma_enable(mima_t *mima, uint32_t cycles_per_word)
+{
+    mima->dma.enabled = mima_true;
+    mima->dma.cycles_per_word = cycles_per_word;
+}
+
+mima_bool mima_device_dma_read(mima_t *mima, mima_register address, mima_word *value)
+{
+    switch (address)
+    {
+    case mima_dma_source:
+        *value = mima->dma.source;
+        return mima_true;
+    case mima_dma_destination:
+        *value = mima->dma.destination;
+        return mima_true;
+    case mima_dma_length:
+        *value = mima->dma.length;
+        return mima_true;
+    case mima_dma_start:
+        *value = 0;
+        return mima_true;
+    default:
+        return mima_false;
+    }
+}
+
+static void mima_device_dma_transfer(mima_t *mima)
+{
+    mima_dma_controller *dma = &mima->dma;
+    uint64_t source_end = (uint64_t)dma->source + dma->length;
+    uint64_t destination_end = (uint64_t)dma->destination + dma->length;
+
+    if (source_end > mima_words || destination_end > mima_words)
+    {
+        log_warn("DMA transfer of %u words from 0x%08x to 0x%08x leaves the memory. Nothing will happen!", dma->length, dma->source, dma->destination);
+        return;
+    }
+
+    mima_memory_move(&mima->memory_unit, dma->destination, dma->source, dma->length);
+
+    dma->transfers++;
+    dma->words += dma->length;
+    mima->counters.cycles += (uint64_t)dma->length * dma->cycles_per_word;
+
+    log_info("  DMA - %u words mem[0x%08x] -> mem[0x%08x]", dma->length, dma->source, dma->destination);
+}
+
+mima_bool mima_device_dma_write(mima_t *mima, mima_register address, mima_word value)
+{
+    switch (address)
+    {
+    case mima_dma_source:
+        mima->dma.source = value;
+        return mima_true;
+    case mima_dma_destination:
+        mima->dma.destination = value;
+        return mima_true;
+    case mima_dma_length:
+        mima->dma.length = value;
+        return mima_true;
+    case mima_dma_start:
+        mima_device_dma_transfer(mima);
+        return mima_true;
+    default:
+        return mima_false;
+    }
+}
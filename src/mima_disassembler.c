@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mima_disassembler.h"
+#include "mima_compiler.h"
+#include "mima_memory.h"
+#include "log.h"
+
+#define MIMA_DISASSEMBLER_CACHE_SIZE (1u << MIMA_DISASSEMBLER_CACHE_LOG2)
+
+typedef struct _mima_disassembler_line
+{
+    mima_register	address;
+    mima_word		word;
+    uint32_t		generation;		// of the labels, 0 = empty
+    char			text[48];
+} mima_disassembler_line;
+
+static mima_disassembler_line line_cache[MIMA_DISASSEMBLER_CACHE_SIZE];
+
+// mima_labels sorted by address for reverse lookups
+static uint32_t *address_index = NULL;
+static uint32_t address_index_count = 0;
+static uint32_t address_index_generation = 0;
+
+static int mima_disassembler_compare_addresses(const void *a, const void *b)
+{
+    uint32_t index_a = *(const uint32_t *)a;
+    uint32_t index_b = *(const uint32_t *)b;
+    uint32_t address_a = mima_labels[index_a].address;
+    uint32_t address_b = mima_labels[index_b].address;
+
+    if (address_a != address_b)
+    {
+        return address_a < address_b ? -1 : 1;
+    }
+
+    // the first declaration wins
+    return (index_a > index_b) - (index_a < index_b);
+}
+
+static void mima_disassembler_update_labels()
+{
+    if (address_index_generation == mima_labels_generation + 1)
+    {
+        return;
+    }
+
+    free(address_index);
+    address_index = malloc((labels_count + 1) * sizeof(uint32_t));
+    address_index_count = 0;
+
+    if (address_index)
+    {
+        for (uint32_t i = 0; i < labels_count; ++i)
+        {
+            address_index[i] = i;
+        }
+
+        qsort(address_index, labels_count, sizeof(uint32_t), mima_disassembler_compare_addresses);
+        address_index_count = labels_count;
+    }
+
+    // + 1 keeps 0 free for empty cache lines
+    address_index_generation = mima_labels_generation + 1;
+}
+
+const char *mima_disassembler_label_at(mima_register address)
+{
+    mima_disassembler_update_labels();
+
+    uint32_t low = 0;
+    uint32_t high = address_index_count;
+
+    // lower bound -> first declaration of duplicates
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (mima_labels[address_index[middle]].address < address)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low < address_index_count && mima_labels[address_index[low]].address == address)
+    {
+        return mima_labels[address_index[low]].label_name;
+    }
+
+    return NULL;
+}
+
+static void mima_disassembler_render(mima_disassembler_line *line, mima_word word)
+{
+    mima_instruction_type op_code;
+    mima_register value;
+
+    if (word >> 28 != 0xF)
+    {
+        op_code = word >> 28;
+        value = word & 0x0FFFFFFF;
+    }
+    else
+    {
+        op_code = word >> 24;
+        value = word & 0x00FFFFFF;
+    }
+
+    const char *name = mima_get_instruction_name(op_code);
+
+    switch (op_code)
+    {
+    case HLT:
+    case NOT:
+    case RAR:
+    case RET:
+        snprintf(line->text, sizeof(line->text), "%s", name);
+        return;
+    case LDC:
+    case RRN:
+    case SHL:
+    case SHR:
+        snprintf(line->text, sizeof(line->text), "%-4s 0x%x", name, value);
+        return;
+    default:
+        break;
+    }
+
+    if (strcmp(name, "INVALID") == 0)
+    {
+        snprintf(line->text, sizeof(line->text), "???");
+        return;
+    }
+
+    // everything else takes an address
+    const char *label = mima_disassembler_label_at(value);
+
+    if (label)
+    {
+        snprintf(line->text, sizeof(line->text), "%-4s %s", name, label);
+    }
+    else
+    {
+        snprintf(line->text, sizeof(line->text), "%-4s 0x%08x", name, value);
+    }
+}
+
+const char *mima_disassemble(mima_register address, mima_word word)
+{
+    mima_disassembler_update_labels();
+
+    mima_disassembler_line *line = &line_cache[address & (MIMA_DISASSEMBLER_CACHE_SIZE - 1)];
+
+    if (line->generation != address_index_generation || line->address != address || line->word != word)
+    {
+        line->address = address;
+        line->word = word;
+        line->generation = address_index_generation;
+        mima_disassembler_render(line, word);
+    }
+
+    return line->text;
+}
+
+void mima_disassembler_print(mima_memory_unit *memory_unit, FILE *out, mima_register address, uint32_t count)
+{
+    static mima_output_buffer buffer;
+    buffer.out = out;
+    buffer.used = 0;
+
+    for (uint32_t i = 0; address + i < mima_words - 1 && i < count; ++i)
+    {
+        mima_register current = address + i;
+        mima_word word = memory_unit->memory[current];
+        const char *label = mima_disassembler_label_at(current);
+
+        if (label)
+        {
+            mima_output_string(&buffer, ":");
+            mima_output_string(&buffer, label);
+            mima_output_string(&buffer, "\n");
+        }
+
+        mima_output_string(&buffer, "mem[0x");
+        mima_output_hex(&buffer, current);
+        mima_output_string(&buffer, "] = 0x");
+        mima_output_hex(&buffer, word);
+        mima_output_string(&buffer, "  ");
+        mima_output_string(&buffer, mima_disassemble(current, word));
+        mima_output_string(&buffer, "\n");
+    }
+
+    mima_output_flush(&buffer);
+}
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "mima_interrupts.h"
+#include "log.h"
+
+static void *mima_input_reader(void *argument)
+{
+    mima_input *input = argument;
+    struct pollfd descriptor = { .fd = STDIN_FILENO, .events = POLLIN };
+    uint8_t buffer[256];
+
+    while (!__atomic_load_n(&input->quit, __ATOMIC_RELAXED))
+    {
+        // wakes up now and then to notice quit
+        int ready = poll(&descriptor, 1, 100);
+
+        if (ready == 0 || (ready < 0 && errno == EINTR))
+        {
+            continue;
+        }
+
+        ssize_t size = ready > 0 ? read(STDIN_FILENO, buffer, sizeof(buffer)) : -1;
+
+        pthread_mutex_lock(&input->mutex);
+
+        if (size <= 0)
+        {
+            input->end = mima_true;
+            pthread_cond_broadcast(&input->condition);
+            pthread_mutex_unlock(&input->mutex);
+            break;
+        }
+
+        for (ssize_t i = 0; i < size; ++i)
+        {
+            if (input->count < MIMA_INPUT_RING)
+            {
+                input->ring[(input->head + input->count++) % MIMA_INPUT_RING] = buffer[i];
+            }
+            else
+            {
+                input->dropped++;
+            }
+        }
+
+        pthread_cond_broadcast(&input->condition);
+        pthread_mutex_unlock(&input->mutex);
+
+        // the engine looks at pending when it reaches due
+        __atomic_fetch_or(&input->controller->pending, mima_irq_input, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&input->controller->due, 0, __ATOMIC_SEQ_CST);
+    }
+
+    return NULL;
+}
+
+static mima_input *mima_input_start(mima_t *mima)
+{
+    mima_interrupt_controller *controller = &mima->interrupts;
+
+    if (controller->input)
+    {
+        return controller->input;
+    }
+
+    mima_input *input = calloc(1, sizeof(mima_input));
+
+    if (!input)
+    {
+        log_error("Could not allocate memory for the input buffer :(");
+        return NULL;
+    }
+
+    input->controller = controller;
+    pthread_mutex_init(&input->mutex, NULL);
+    pthread_cond_init(&input->condition, NULL);
+
+    if (pthread_create(&input->thread, NULL, mima_input_reader, input) != 0)
+    {
+        log_error("Could not start the input thread :(");
+        pthread_mutex_destroy(&input->mutex);
+        pthread_cond_destroy(&input->condition);
+        free(input);
+        return NULL;
+    }
+
+    controller->input = input;
+    return input;
+}
+
+static int mima_input_pop(mima_input *input, mima_bool wait)
+{
+    int byte = -1;
+
+    pthread_mutex_lock(&input->mutex);
+
+    while (wait && input->count == 0 && !input->end)
+    {
+        pthread_cond_wait(&input->condition, &input->mutex);
+    }
+
+    if (input->count > 0)
+    {
+        byte = input->ring[input->head];
+        input->head = (input->head + 1) % MIMA_INPUT_RING;
+        input->count--;
+    }
+
+    pthread_mutex_unlock(&input->mutex);
+    return byte;
+}
+
+// Bytes read outside of mima_input_data: the input interrupt is pending again only if bytes are left for the handler.
+static void mima_input_consumed(mima_input *input)
+{
+    pthread_mutex_lock(&input->mutex);
+
+    if (input->count > 0)
+    {
+        __atomic_fetch_or(&input->controller->pending, mima_irq_input, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&input->controller->due, 0, __ATOMIC_SEQ_CST);
+    }
+    else
+    {
+        __atomic_fetch_and(&input->controller->pending, ~mima_irq_input, __ATOMIC_SEQ_CST);
+    }
+
+    pthread_mutex_unlock(&input->mutex);
+}
+
+int mima_input_getchar(mima_t *mima)
+{
+    mima_input *input = mima->interrupts.input;
+
+    if (!input)
+    {
+        return getchar();
+    }
+
+    int byte = mima_input_pop(input, mima_true);
+    mima_input_consumed(input);
+    return byte;
+}
+
+char *mima_input_gets(mima_t *mima, char *buffer, int size)
+{
+    mima_input *input = mima->interrupts.input;
+
+    if (!input)
+    {
+        return fgets(buffer, size, stdin);
+    }
+
+    int length = 0;
+
+    while (length < size - 1)
+    {
+        int byte = mima_input_pop(input, mima_true);
+
+        if (byte < 0)
+        {
+            break;
+        }
+
+        buffer[length++] = byte;
+
+        if (byte == '\n')
+        {
+            break;
+        }
+    }
+
+    buffer[length] = 0;
+    mima_input_consumed(input);
+    return length > 0 ? buffer : NULL;
+}
+
+void mima_interrupts_enable(mima_t *mima)
+{
+    mima->interrupts.enabled = mima_true;
+
+    // stdio must not read ahead, the input thread reads the descriptor itself once it runs
+    setvbuf(stdin, NULL, _IONBF, 0);
+}
+
+void mima_interrupts_delete(mima_t *mima)
+{
+    mima_input *input = mima->interrupts.input;
+
+    if (!input)
+    {
+        return;
+    }
+
+    __atomic_store_n(&input->quit, mima_true, __ATOMIC_RELAXED);
+    pthread_join(input->thread, NULL);
+
+    if (input->dropped)
+    {
+        log_warn("Dropped %llu input byte(s), the program did not read them in time.", (unsigned long long)input->dropped);
+    }
+
+    pthread_mutex_destroy(&input->mutex);
+    pthread_cond_destroy(&input->condition);
+    free(input);
+    mima->interrupts.input = NULL;
+}
+
+void mima_interrupts_check(mima_t *mima)
+{
+    mima_interrupt_controller *controller = &mima->interrupts;
+    uint64_t instructions = mima->counters.instructions;
+
+    if (controller->period && instructions >= controller->next_tick)
+    {
+        __atomic_fetch_or(&controller->pending, mima_irq_timer, __ATOMIC_SEQ_CST);
+        controller->next_tick = instructions + controller->period;
+    }
+
+    // due first, then pending: input that arrives in between sets due to 0 again
+    __atomic_store_n(&controller->due, controller->period ? controller->next_tick : UINT64_MAX, __ATOMIC_SEQ_CST);
+    uint32_t pending = __atomic_load_n(&controller->pending, __ATOMIC_SEQ_CST) & controller->mask;
+
+    if (!pending || controller->active || !mima->control_unit.RUN)
+    {
+        return;
+    }
+
+    controller->saved_IAR = mima->control_unit.IAR;
+    controller->saved_ACC = mima->processing_unit.ACC;
+    controller->active = mima_true;
+    controller->delivered++;
+    mima->control_unit.IAR = controller->vector;
+
+    log_info("  IRQ - 0x%x to 0x%08x, returning to 0x%08x", pending, controller->vector, controller->saved_IAR);
+}
+
+mima_bool mima_interrupts_read(mima_t *mima, mima_register address, mima_word *value)
+{
+    mima_interrupt_controller *controller = &mima->interrupts;
+    mima_input *input;
+
+    switch (address)
+    {
+    case mima_irq_vector:
+        *value = controller->vector;
+        return mima_true;
+    case mima_irq_enable:
+        *value = controller->mask;
+        return mima_true;
+    case mima_irq_status:
+        *value = __atomic_load_n(&controller->pending, __ATOMIC_SEQ_CST);
+        return mima_true;
+    case mima_timer_period:
+        *value = controller->period;
+        return mima_true;
+    case mima_irq_saved_iar:
+        *value = controller->saved_IAR;
+        return mima_true;
+    case mima_irq_saved_acc:
+        *value = controller->saved_ACC;
+        return mima_true;
+    case mima_irq_return:
+        *value = controller->active;
+        return mima_true;
+    case mima_input_data:
+        input = mima_input_start(mima);
+        *value = input ? mima_input_pop(input, mima_false) : -1;
+        return mima_true;
+    default:
+        return mima_false;
+    }
+}
+
+mima_bool mima_interrupts_write(mima_t *mima, mima_register address, mima_word value)
+{
+    mima_interrupt_controller *controller = &mima->interrupts;
+
+    switch (address)
+    {
+    case mima_irq_vector:
+        controller->vector = value;
+        return mima_true;
+    case mima_irq_enable:
+        controller->mask = value;
+
+        if (value & mima_irq_input)
+        {
+            mima_input_start(mima);
+        }
+        break;
+    case mima_irq_status:
+        __atomic_fetch_and(&controller->pending, ~value, __ATOMIC_SEQ_CST);
+        return mima_true;
+    case mima_timer_period:
+        controller->period = value;
+        controller->next_tick = mima->counters.instructions + value;
+        break;
+    case mima_irq_saved_iar:
+        controller->saved_IAR = value;
+        return mima_true;
+    case mima_irq_saved_acc:
+        controller->saved_ACC = value;
+        return mima_true;
+    case mima_irq_return:
+        mima->control_unit.IAR = controller->saved_IAR;
+        mima->processing_unit.ACC = controller->saved_ACC;
+        controller->active = mima_false;
+        log_info(" IRET - to 0x%08x", controller->saved_IAR);
+        break;
+    default:
+        return mima_false;
+    }
+
+    // a pending interrupt may be deliverable now
+    __atomic_store_n(&controller->due, 0, __ATOMIC_SEQ_CST);
+    return mima_true;
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mima_iolog.h"
+#include "log.h"
+
+static const char mima_io_log_magic[8] = "MIMAIO1\n";
+
+mima_io_log *mima_io_log_open(const char *file_name, mima_bool replay)
+{
+    FILE *file = fopen(file_name, replay ? "rb" : "wb");
+
+    if (!file)
+    {
+        log_error("Failed to open %s :(", file_name);
+        return NULL;
+    }
+
+    char magic[sizeof(mima_io_log_magic)];
+
+    if (replay ? fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, mima_io_log_magic, sizeof(magic)) != 0
+               : fwrite(mima_io_log_magic, sizeof(mima_io_log_magic), 1, file) != 1)
+    {
+        log_error("%s is not an I/O recording :(", file_name);
+        fclose(file);
+        return NULL;
+    }
+
+    mima_io_log *io_log = calloc(1, sizeof(mima_io_log));
+
+    if (!io_log)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    io_log->file = file;
+    io_log->replay = replay;
+    return io_log;
+}
+
+void mima_io_log_close(mima_io_log *io_log)
+{
+    if (!io_log)
+    {
+        return;
+    }
+
+    log_info("%s %llu I/O reads", io_log->replay ? "Replayed" : "Recorded", (unsigned long long)io_log->records);
+    fclose(io_log->file);
+    free(io_log);
+}
+
+static void mima_io_log_put_varint(FILE *file, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc((int)(value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+
+    fputc((int)value, file);
+}
+
+static mima_bool mima_io_log_get_varint(FILE *file, uint64_t *value)
+{
+    *value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int byte = fgetc(file);
+
+        if (byte == EOF)
+        {
+            return mima_false;
+        }
+
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+        {
+            return mima_true;
+        }
+    }
+
+    return mima_false;
+}
+
+void mima_io_log_record(mima_io_log *io_log, uint64_t instruction, mima_register address, mima_word value)
+{
+    mima_io_log_put_varint(io_log->file, instruction - io_log->instruction);
+    fputc((int)(address - 0xc000000), io_log->file);
+    mima_io_log_put_varint(io_log->file, value);
+
+    // a session may end with a crash or ^C, keep what we have
+    fflush(io_log->file);
+
+    io_log->instruction = instruction;
+    io_log->records++;
+}
+
+mima_bool mima_io_log_replay(mima_io_log *io_log, uint64_t instruction, mima_register address, mima_word *value)
+{
+    uint64_t delta;
+    uint64_t word;
+    int device;
+
+    if (!mima_io_log_get_varint(io_log->file, &delta) || (device = fgetc(io_log->file)) == EOF || !mima_io_log_get_varint(io_log->file, &word))
+    {
+        log_warn("The I/O recording ends after %llu reads.", (unsigned long long)io_log->records);
+        return mima_false;
+    }
+
+    io_log->instruction += delta;
+    io_log->records++;
+
+    if (io_log->instruction != instruction || 0xc000000 + (mima_register)device != address)
+    {
+        log_warn("Replay diverged: read %llu was recorded from 0x%08x at instruction %llu, now 0x%08x at %llu.",
+                 (unsigned long long)io_log->records, 0xc000000 + device, (unsigned long long)io_log->instruction, address, (unsigned long long)instruction);
+        io_log->instruction = instruction;
+    }
+
+    *value = (mima_word)word;
+    return mima_true;
+}
+
+uint64_t mima_io_log_tell(mima_io_log *io_log)
+{
+    long offset = ftell(io_log->file);
+    return offset > 0 ? (uint64_t)offset : 0;
+}
+
+mima_bool mima_io_log_seek(mima_io_log *io_log, uint64_t offset, uint64_t instruction, uint64_t records)
+{
+    if (offset < sizeof(mima_io_log_magic) || fseek(io_log->file, (long)offset, SEEK_SET) != 0)
+    {
+        return mima_false;
+    }
+
+    io_log->instruction = instruction;
+    io_log->records = records;
+    return mima_true;
+}
@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "mima_memory.h"
+#include "log.h"
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// between the engine and the checkpoint writer
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void mima_output_flush(mima_output_buffer *buffer)
+{
+    fwrite(buffer->data, 1, buffer->used, buffer->out);
+    buffer->used = 0;
+}
+
+static void mima_output_reserve(mima_output_buffer *buffer, size_t size)
+{
+    if (buffer->used + size > mima_output_buffer_size)
+    {
+        mima_output_flush(buffer);
+    }
+}
+
+void mima_output_string(mima_output_buffer *buffer, const char *string)
+{
+    size_t length = strlen(string);
+    mima_output_reserve(buffer, length);
+    memcpy(&buffer->data[buffer->used], string, length);
+    buffer->used += length;
+}
+
+void mima_output_hex(mima_output_buffer *buffer, uint32_t value)
+{
+    mima_output_reserve(buffer, 8);
+
+    for (int i = 7; i >= 0; --i)
+    {
+        buffer->data[buffer->used + i] = hex_digits[value & 0xF];
+        value >>= 4;
+    }
+
+    buffer->used += 8;
+}
+
+static void mima_output_binary(mima_output_buffer *buffer, const void *data, size_t size)
+{
+    if (size > mima_output_buffer_size)
+    {
+        mima_output_flush(buffer);
+        fwrite(data, 1, size, buffer->out);
+        return;
+    }
+
+    mima_output_reserve(buffer, size);
+    memcpy(&buffer->data[buffer->used], data, size);
+    buffer->used += size;
+}
+
+// binary dumps are a sequence of regions: address, word count, words (host byte order)
+static void mima_output_region(mima_output_buffer *buffer, mima_register address, const mima_word *words, uint32_t count)
+{
+    uint32_t header[2] = { address, count };
+    mima_output_binary(buffer, header, sizeof(header));
+    mima_output_binary(buffer, words, count * sizeof(mima_word));
+}
+
+static void mima_output_words(mima_output_buffer *buffer, mima_register address, const mima_word *words, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i += 8)
+    {
+        mima_output_string(buffer, "0x");
+        mima_output_hex(buffer, address + i);
+        mima_output_string(buffer, ":");
+
+        for (uint32_t j = i; j < count && j < i + 8; ++j)
+        {
+            mima_output_string(buffer, " ");
+            mima_output_hex(buffer, words[j]);
+        }
+
+        mima_output_string(buffer, "\n");
+    }
+}
+
+mima_bool mima_memory_init(mima_memory_unit *memory_unit)
+{
+    // anonymous pages read as zero and devices can map files into the guest address space
+    void *memory = mmap(NULL, mima_words * sizeof(mima_word), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    memory_unit->memory = memory == MAP_FAILED ? NULL : memory;
+    memory_unit->dirty_pages = calloc((mima_pages + 63) / 64, sizeof(uint64_t));
+    memory_unit->baseline_pages = calloc(mima_pages, sizeof(mima_word *));
+
+    return memory_unit->memory && memory_unit->dirty_pages && memory_unit->baseline_pages;
+}
+
+void mima_memory_delete(mima_memory_unit *memory_unit)
+{
+    if (memory_unit->baseline_pages)
+    {
+        mima_memory_reset_baseline(memory_unit);
+    }
+
+    if (memory_unit->memory)
+    {
+        munmap(memory_unit->memory, mima_words * sizeof(mima_word));
+    }
+
+    mima_memory_snapshot_end(memory_unit);
+
+    free(memory_unit->dirty_pages);
+    free(memory_unit->baseline_pages);
+    free(memory_unit->snapshot_pages);
+}
+
+void mima_memory_save_baseline_page(mima_memory_unit *memory_unit, uint32_t page)
+{
+    mima_word *copy = malloc(mima_page_words * sizeof(mima_word));
+
+    if (!copy)
+    {
+        log_fatal("Could not allocate memory for the memory baseline :(");
+        assert(0);
+    }
+
+    memcpy(copy, &memory_unit->memory[page << mima_page_words_log2], mima_page_words * sizeof(mima_word));
+
+    // two cores may write into the page at the same time, the first copy wins
+    mima_word *expected = NULL;
+
+    if (!__atomic_compare_exchange_n(&memory_unit->baseline_pages[page], &expected, copy, mima_false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+        free(copy);
+    }
+}
+
+void mima_memory_reset_baseline(mima_memory_unit *memory_unit)
+{
+    for (uint32_t page = 0; page < mima_pages; ++page)
+    {
+        free(memory_unit->baseline_pages[page]);
+        memory_unit->baseline_pages[page] = NULL;
+    }
+}
+
+void mima_memory_mark_dirty_range(mima_memory_unit *memory_unit, mima_register address, uint32_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    uint32_t last = mima_page_of(address + count - 1);
+
+    for (uint32_t page = mima_page_of(address); page <= last; ++page)
+    {
+        mima_memory_mark_dirty(memory_unit, page);
+    }
+}
+
+static void mima_memory_prepare_range(mima_memory_unit *memory_unit, mima_register address, uint32_t count)
+{
+    uint32_t last = mima_page_of(address + count - 1);
+
+    for (uint32_t page = mima_page_of(address); page <= last; ++page)
+    {
+        mima_memory_prepare_page(memory_unit, page);
+    }
+}
+
+uint32_t mima_memory_snapshot_begin(mima_memory_unit *memory_unit, uint64_t *pages)
+{
+    uint32_t words = (mima_pages + 63) / 64;
+    uint64_t *pending = malloc(words * sizeof(uint64_t));
+
+    if (!memory_unit->snapshot_pages)
+    {
+        memory_unit->snapshot_pages = calloc(mima_pages, sizeof(mima_word *));
+    }
+
+    if (!pending || !memory_unit->snapshot_pages)
+    {
+        log_fatal("Could not allocate memory for the snapshot :(");
+        assert(0);
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < words; ++i)
+    {
+        pending[i] = pages[i] = memory_unit->dirty_pages[i];
+        count += __builtin_popcountll(pages[i]);
+    }
+
+    // pages that were never written are zero and not part of the snapshot
+    memory_unit->snapshot_pending = pending;
+    return count;
+}
+
+void mima_memory_snapshot_save_page(mima_memory_unit *memory_unit, uint32_t page)
+{
+    pthread_mutex_lock(&snapshot_mutex);
+
+    // the reader may have been faster
+    if ((memory_unit->snapshot_pending[page >> 6] >> (page & 63)) & 1)
+    {
+        mima_word *copy = malloc(mima_page_words * sizeof(mima_word));
+
+        if (!copy)
+        {
+            log_fatal("Could not allocate memory for the snapshot :(");
+            assert(0);
+        }
+
+        memcpy(copy, &memory_unit->memory[page << mima_page_words_log2], mima_page_words * sizeof(mima_word));
+        memory_unit->snapshot_pages[page] = copy;
+        __atomic_and_fetch(&memory_unit->snapshot_pending[page >> 6], ~(1ull << (page & 63)), __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&snapshot_mutex);
+}
+
+void mima_memory_snapshot_read_page(mima_memory_unit *memory_unit, uint32_t page, mima_word *words)
+{
+    pthread_mutex_lock(&snapshot_mutex);
+
+    if ((memory_unit->snapshot_pending[page >> 6] >> (page & 63)) & 1)
+    {
+        // the engine does not touch the page before the bit is cleared
+        memcpy(words, &memory_unit->memory[page << mima_page_words_log2], mima_page_words * sizeof(mima_word));
+        __atomic_and_fetch(&memory_unit->snapshot_pending[page >> 6], ~(1ull << (page & 63)), __ATOMIC_RELEASE);
+    }
+    else
+    {
+        memcpy(words, memory_unit->snapshot_pages[page], mima_page_words * sizeof(mima_word));
+        free(memory_unit->snapshot_pages[page]);
+        memory_unit->snapshot_pages[page] = NULL;
+    }
+
+    pthread_mutex_unlock(&snapshot_mutex);
+}
+
+void mima_memory_snapshot_end(mima_memory_unit *memory_unit)
+{
+    if (!memory_unit->snapshot_pending)
+    {
+        return;
+    }
+
+    // copies of pages that were never read (an aborted snapshot)
+    for (uint32_t page = 0; page < mima_pages; ++page)
+    {
+        free(memory_unit->snapshot_pages[page]);
+        memory_unit->snapshot_pages[page] = NULL;
+    }
+
+    free(memory_unit->snapshot_pending);
+    memory_unit->snapshot_pending = NULL;
+}
+
+void mima_memory_move(mima_memory_unit *memory_unit, mima_register destination, mima_register source, uint32_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    mima_memory_prepare_range(memory_unit, destination, count);
+    memmove(&memory_unit->memory[destination], &memory_unit->memory[source], (size_t)count * sizeof(mima_word));
+}
+
+void mima_memory_write_block(mima_memory_unit *memory_unit, mima_register address, const mima_word *words, uint32_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    mima_memory_prepare_range(memory_unit, address, count);
+    memcpy(&memory_unit->memory[address], words, (size_t)count * sizeof(mima_word));
+}
+
+void mima_memory_dump_dirty(mima_memory_unit *memory_unit, FILE *out, mima_bool binary)
+{
+    static mima_output_buffer buffer;
+    buffer.out = out;
+    buffer.used = 0;
+
+    uint32_t regions = 0;
+    uint32_t page = 0;
+    while (page < mima_pages)
+    {
+        // skip 64 clean pages at once
+        if ((page & 63) == 0 && memory_unit->dirty_pages[page >> 6] == 0)
+        {
+            page += 64;
+            continue;
+        }
+
+        if (!mima_memory_page_dirty(memory_unit, page))
+        {
+            page++;
+            continue;
+        }
+
+        // merge adjacent dirty pages into one region
+        uint32_t first = page;
+        while (page < mima_pages && mima_memory_page_dirty(memory_unit, page))
+        {
+            page++;
+        }
+
+        mima_register address = first << mima_page_words_log2;
+        uint32_t count = (page - first) << mima_page_words_log2;
+
+        if (address + count > mima_words)
+        {
+            count = mima_words - address;
+        }
+
+        if (binary)
+        {
+            mima_output_region(&buffer, address, &memory_unit->memory[address], count);
+        }
+        else
+        {
+            mima_output_string(&buffer, "# dirty region 0x");
+            mima_output_hex(&buffer, address);
+            mima_output_string(&buffer, " - 0x");
+            mima_output_hex(&buffer, address + count - 1);
+            mima_output_string(&buffer, "\n");
+            mima_output_words(&buffer, address, &memory_unit->memory[address], count);
+        }
+
+        regions++;
+    }
+
+    mima_output_flush(&buffer);
+    log_info("Dumped %u dirty region(s).", regions);
+}
+
+void mima_memory_diff(mima_memory_unit *memory_unit, FILE *out, mima_bool binary)
+{
+    static mima_output_buffer buffer;
+    buffer.out = out;
+    buffer.used = 0;
+
+    uint32_t changed = 0;
+    for (uint32_t page = 0; page < mima_pages; ++page)
+    {
+        // pages without a baseline copy were not written since the baseline
+        const mima_word *baseline = memory_unit->baseline_pages[page];
+
+        if (!baseline)
+        {
+            continue;
+        }
+
+        mima_register base = page << mima_page_words_log2;
+        const mima_word *current = &memory_unit->memory[base];
+
+        uint32_t i = 0;
+        while (i < mima_page_words)
+        {
+            if (baseline[i] == current[i])
+            {
+                i++;
+                continue;
+            }
+
+            // collect the run of changed words
+            uint32_t first = i;
+            while (i < mima_page_words && baseline[i] != current[i])
+            {
+                i++;
+            }
+
+            if (binary)
+            {
+                mima_output_region(&buffer, base + first, &current[first], i - first);
+            }
+            else
+            {
+                for (uint32_t j = first; j < i; ++j)
+                {
+                    mima_output_string(&buffer, "0x");
+                    mima_output_hex(&buffer, base + j);
+                    mima_output_string(&buffer, ": ");
+                    mima_output_hex(&buffer, baseline[j]);
+                    mima_output_string(&buffer, " -> ");
+                    mima_output_hex(&buffer, current[j]);
+                    mima_output_string(&buffer, "\n");
+                }
+            }
+
+            changed += i - first;
+        }
+    }
+
+    mima_output_flush(&buffer);
+    log_info("%u word(s) changed since the baseline.", changed);
+}
+
+void mima_memory_print(mima_memory_unit *memory_unit, FILE *out, mima_register address, uint32_t count)
+{
+    static mima_output_buffer buffer;
+    buffer.out = out;
+    buffer.used = 0;
+
+    for (uint32_t i = 0; address + i < mima_words - 1 && i < count; ++i)
+    {
+        mima_output_string(&buffer, "mem[0x");
+        mima_output_hex(&buffer, address + i);
+        mima_output_string(&buffer, "] = 0x");
+        mima_output_hex(&buffer, memory_unit->memory[address + i]);
+        mima_output_string(&buffer, "\n");
+    }
+
+    mima_output_flush(&buffer);
+}
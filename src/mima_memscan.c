@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "mima_memscan.h"
+#include "mima_memory.h"
+#include "log.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MIMA_SCAN_X86
+#include <immintrin.h>
+#endif
+
+typedef enum _mima_scan_kernel
+{
+    MIMA_SCAN_UNKNOWN = 0, MIMA_SCAN_SCALAR, MIMA_SCAN_SSE2, MIMA_SCAN_AVX2
+} mima_scan_kernel;
+
+static mima_scan_kernel scan_kernel = MIMA_SCAN_UNKNOWN;
+
+static mima_scan_kernel mima_scan_select_kernel()
+{
+    if (scan_kernel == MIMA_SCAN_UNKNOWN)
+    {
+#ifdef MIMA_SCAN_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+        {
+            scan_kernel = MIMA_SCAN_AVX2;
+        }
+        else if (__builtin_cpu_supports("sse2"))
+        {
+            scan_kernel = MIMA_SCAN_SSE2;
+        }
+        else
+#endif
+        {
+            scan_kernel = MIMA_SCAN_SCALAR;
+        }
+    }
+
+    return scan_kernel;
+}
+
+const char *mima_scan_kernel_name()
+{
+    switch (mima_scan_select_kernel())
+    {
+    case MIMA_SCAN_AVX2:
+        return "AVX2";
+    case MIMA_SCAN_SSE2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
+
+static uint32_t mima_scan_find_scalar(const mima_word *words, uint32_t count, mima_word value)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (words[i] == value)
+        {
+            return i;
+        }
+    }
+
+    return count;
+}
+
+static void mima_scan_fill_scalar(mima_word *words, uint32_t count, mima_word value)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        words[i] = value;
+    }
+}
+
+static void mima_scan_checksum_scalar(const mima_word *words, uint32_t count, mima_checksum *checksum)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        checksum->sum += words[i];
+        checksum->xor ^= words[i];
+    }
+}
+
+#ifdef MIMA_SCAN_X86
+
+__attribute__((target("sse2")))
+static uint32_t mima_scan_find_sse2(const mima_word *words, uint32_t count, mima_word value)
+{
+    __m128i needle = _mm_set1_epi32(value);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)&words[i]);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, needle)));
+
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    uint32_t rest = mima_scan_find_scalar(&words[i], count - i, value);
+    return i + rest;
+}
+
+__attribute__((target("sse2")))
+static void mima_scan_fill_sse2(mima_word *words, uint32_t count, mima_word value)
+{
+    __m128i block = _mm_set1_epi32(value);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_si128((__m128i *)&words[i], block);
+    }
+
+    mima_scan_fill_scalar(&words[i], count - i, value);
+}
+
+__attribute__((target("sse2")))
+static void mima_scan_checksum_sse2(const mima_word *words, uint32_t count, mima_checksum *checksum)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+    __m128i xor = _mm_setzero_si128();
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)&words[i]);
+        xor = _mm_xor_si128(xor, block);
+
+        // widen to 64 bit lanes so the sum does not overflow
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(block, zero));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(block, zero));
+    }
+
+    uint64_t sums[2];
+    uint32_t xors[4];
+    _mm_storeu_si128((__m128i *)sums, sum);
+    _mm_storeu_si128((__m128i *)xors, xor);
+    checksum->sum += sums[0] + sums[1];
+    checksum->xor ^= xors[0] ^ xors[1] ^ xors[2] ^ xors[3];
+
+    mima_scan_checksum_scalar(&words[i], count - i, checksum);
+}
+
+__attribute__((target("avx2")))
+static uint32_t mima_scan_find_avx2(const mima_word *words, uint32_t count, mima_word value)
+{
+    __m256i needle = _mm256_set1_epi32(value);
+    uint32_t i = 0;
+
+    // two blocks per iteration, the compare result is only inspected once
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i low = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&words[i]), needle);
+        __m256i high = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&words[i + 8]), needle);
+
+        if (!_mm256_testz_si256(_mm256_or_si256(low, high), _mm256_or_si256(low, high)))
+        {
+            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(low)) | (_mm256_movemask_ps(_mm256_castsi256_ps(high)) << 8);
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    uint32_t rest = mima_scan_find_scalar(&words[i], count - i, value);
+    return i + rest;
+}
+
+__attribute__((target("avx2")))
+static void mima_scan_fill_avx2(mima_word *words, uint32_t count, mima_word value)
+{
+    __m256i block = _mm256_set1_epi32(value);
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256((__m256i *)&words[i], block);
+    }
+
+    mima_scan_fill_scalar(&words[i], count - i, value);
+}
+
+__attribute__((target("avx2")))
+static void mima_scan_checksum_avx2(const mima_word *words, uint32_t count, mima_checksum *checksum)
+{
+    __m256i sum = _mm256_setzero_si256();
+    __m256i xor = _mm256_setzero_si256();
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)&words[i]);
+        xor = _mm256_xor_si256(xor, block);
+
+        // widen to 64 bit lanes so the sum does not overflow
+        sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(block)));
+        sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(block, 1)));
+    }
+
+    uint64_t sums[4];
+    uint32_t xors[8];
+    _mm256_storeu_si256((__m256i *)sums, sum);
+    _mm256_storeu_si256((__m256i *)xors, xor);
+    checksum->sum += sums[0] + sums[1] + sums[2] + sums[3];
+
+    for (int j = 0; j < 8; ++j)
+    {
+        checksum->xor ^= xors[j];
+    }
+
+    mima_scan_checksum_scalar(&words[i], count - i, checksum);
+}
+
+#endif // MIMA_SCAN_X86
+
+uint32_t mima_scan_find(const mima_word *words, uint32_t count, mima_word value)
+{
+    switch (mima_scan_select_kernel())
+    {
+#ifdef MIMA_SCAN_X86
+    case MIMA_SCAN_AVX2:
+        return mima_scan_find_avx2(words, count, value);
+    case MIMA_SCAN_SSE2:
+        return mima_scan_find_sse2(words, count, value);
+#endif
+    default:
+        return mima_scan_find_scalar(words, count, value);
+    }
+}
+
+void mima_scan_fill(mima_word *words, uint32_t count, mima_word value)
+{
+    switch (mima_scan_select_kernel())
+    {
+#ifdef MIMA_SCAN_X86
+    case MIMA_SCAN_AVX2:
+        mima_scan_fill_avx2(words, count, value);
+        break;
+    case MIMA_SCAN_SSE2:
+        mima_scan_fill_sse2(words, count, value);
+        break;
+#endif
+    default:
+        mima_scan_fill_scalar(words, count, value);
+        break;
+    }
+}
+
+void mima_scan_checksum(const mima_word *words, uint32_t count, mima_checksum *checksum)
+{
+    switch (mima_scan_select_kernel())
+    {
+#ifdef MIMA_SCAN_X86
+    case MIMA_SCAN_AVX2:
+        mima_scan_checksum_avx2(words, count, checksum);
+        break;
+    case MIMA_SCAN_SSE2:
+        mima_scan_checksum_sse2(words, count, checksum);
+        break;
+#endif
+    default:
+        mima_scan_checksum_scalar(words, count, checksum);
+        break;
+    }
+}
+
+// Clamps [address, address + count) to general purpose memory.
+static uint32_t mima_memory_clamp(mima_register address, uint32_t count)
+{
+    if (address >= mima_words)
+    {
+        return 0;
+    }
+
+    if (count > mima_words - address)
+    {
+        count = mima_words - address;
+    }
+
+    return count;
+}
+
+uint32_t mima_memory_find(mima_memory_unit *memory_unit, mima_register address, uint32_t count, mima_word value, mima_register *matches, uint32_t max_matches)
+{
+    count = mima_memory_clamp(address, count);
+
+    uint32_t found = 0;
+    mima_register end = address + count;
+    while (address < end)
+    {
+        uint32_t page = mima_page_of(address);
+        mima_register page_end = (page + 1) << mima_page_words_log2;
+
+        if (page_end > end)
+        {
+            page_end = end;
+        }
+
+        if (!mima_memory_page_dirty(memory_unit, page))
+        {
+            // never written -> all zero
+            if (value == 0)
+            {
+                uint32_t zeros = page_end - address;
+
+                for (uint32_t i = 0; i < zeros && found + i < max_matches; ++i)
+                {
+                    matches[found + i] = address + i;
+                }
+
+                found += zeros;
+            }
+
+            address = page_end;
+            continue;
+        }
+
+        const mima_word *words = &memory_unit->memory[address];
+        uint32_t remaining = page_end - address;
+        uint32_t index;
+        while ((index = mima_scan_find(words, remaining, value)) < remaining)
+        {
+            if (found < max_matches)
+            {
+                matches[found] = address + (words - &memory_unit->memory[address]) + index;
+            }
+
+            found++;
+            words += index + 1;
+            remaining -= index + 1;
+        }
+
+        address = page_end;
+    }
+
+    return found;
+}
+
+void mima_memory_fill(mima_memory_unit *memory_unit, mima_register address, uint32_t count, mima_word value)
+{
+    count = mima_memory_clamp(address, count);
+
+    mima_register end = address + count;
+    while (address < end)
+    {
+        uint32_t page = mima_page_of(address);
+        mima_register page_end = (page + 1) << mima_page_words_log2;
+
+        if (page_end > end)
+        {
+            page_end = end;
+        }
+
+        // same bookkeeping as mima_memory_write(), once per page
+        mima_memory_prepare_page(memory_unit, page);
+
+        mima_scan_fill(&memory_unit->memory[address], page_end - address, value);
+        address = page_end;
+    }
+}
+
+void mima_memory_checksum(mima_memory_unit *memory_unit, mima_register address, uint32_t count, mima_checksum *checksum)
+{
+    count = mima_memory_clamp(address, count);
+
+    checksum->sum = 0;
+    checksum->xor = 0;
+
+    mima_register end = address + count;
+    while (address < end)
+    {
+        uint32_t page = mima_page_of(address);
+        mima_register page_end = (page + 1) << mima_page_words_log2;
+
+        if (page_end > end)
+        {
+            page_end = end;
+        }
+
+        // zero words change neither sum nor xor
+        if (mima_memory_page_dirty(memory_unit, page))
+        {
+            mima_scan_checksum(&memory_unit->memory[address], page_end - address, checksum);
+        }
+
+        address = page_end;
+    }
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mima_optimizer.h"
+#include "mima_compiler.h"
+#include "log.h"
+
+mima_bool mima_optimize = mima_false;
+
+static mima_instruction mima_optimizer_decode(mima_word word)
+{
+    mima_instruction instruction;
+
+    if (word >> 28 != 0xF)
+    {
+        instruction.op_code = word >> 28;
+        instruction.value = word & 0x0FFFFFFF;
+        instruction.extended = mima_false;
+    }
+    else
+    {
+        instruction.op_code = word >> 24;
+        instruction.value = word & 0x00FFFFFF;
+        instruction.extended = mima_true;
+    }
+
+    return instruction;
+}
+
+// the value is a memory address or jump target (LDC, RRN, SHL and SHR take constants)
+static mima_bool mima_optimizer_is_address(mima_instruction_type op_code)
+{
+    switch (op_code)
+    {
+    case ADD:
+    case AND:
+    case OR:
+    case XOR:
+    case LDV:
+    case STV:
+    case JMP:
+    case JMN:
+    case EQL:
+    case MUL:
+    case SUB:
+    case LDIV:
+    case STIV:
+    case CALL:
+        return mima_true;
+    default:
+        return mima_false;
+    }
+}
+
+// Code that refers to its own addresses by number or writes into itself would break when it moves.
+static mima_bool mima_optimizer_can_move(const mima_word *instructions, const uint32_t *lines, const uint8_t *label_operands, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        mima_instruction instruction = mima_optimizer_decode(instructions[i]);
+
+        if (instruction.op_code == STIV || (instruction.op_code == STV && instruction.value < count))
+        {
+            log_info("%s: %s may write into the code, not optimizing.", mima_assembled_location(lines[i]), mima_get_instruction_name(instruction.op_code));
+            return mima_false;
+        }
+
+        if (mima_optimizer_is_address(instruction.op_code) && !label_operands[i] && instruction.value <= count)
+        {
+            log_info("%s: 0x%08x is a numeric address inside of the code, not optimizing.", mima_assembled_location(lines[i]), instruction.value);
+            return mima_false;
+        }
+    }
+
+    return mima_true;
+}
+
+size_t mima_optimize_code(mima_word *instructions, uint32_t *lines, uint8_t *label_operands, size_t count, uint32_t *relocation)
+{
+    if (count == 0 || !mima_optimizer_can_move(instructions, lines, label_operands, count))
+    {
+        return count;
+    }
+
+    // a label in the middle of a pattern means it can be entered there
+    uint8_t *labeled = calloc(count + 1, sizeof(uint8_t));
+
+    if (!labeled)
+    {
+        log_fatal("Could not allocate memory for the optimizer :(");
+        assert(0);
+    }
+
+    for (uint32_t i = 0; i < labels_count; ++i)
+    {
+        if (mima_labels[i].address <= count)
+        {
+            labeled[mima_labels[i].address] = 1;
+        }
+    }
+
+    uint32_t store_loads = 0;
+    uint32_t zero_adds = 0;
+    uint32_t double_nots = 0;
+    size_t kept = 0;
+    size_t i = 0;
+    while (i < count)
+    {
+        mima_instruction first = mima_optimizer_decode(instructions[i]);
+        relocation[i] = kept;
+
+        if (i + 1 < count && !labeled[i + 1])
+        {
+            mima_instruction second = mima_optimizer_decode(instructions[i + 1]);
+
+            // the stored value is still in ACC
+            if (first.op_code == STV && second.op_code == LDV && first.value == second.value && first.value < 0xC000000)
+            {
+                relocation[i + 1] = kept + 1;
+                instructions[kept] = instructions[i];
+                lines[kept] = lines[i];
+                label_operands[kept++] = label_operands[i];
+                store_loads++;
+                i += 2;
+                continue;
+            }
+
+            // 0 + mem[y] = mem[y]
+            if (first.op_code == LDC && first.value == 0 && second.op_code == ADD && second.value < 0xC000000)
+            {
+                relocation[i + 1] = kept + 1;
+                mima_assemble_instruction(&instructions[kept], LDV, second.value, lines[i]);
+                lines[kept] = lines[i];
+                label_operands[kept++] = label_operands[i + 1];
+                zero_adds++;
+                i += 2;
+                continue;
+            }
+
+            if (first.op_code == NOT && second.op_code == NOT)
+            {
+                relocation[i + 1] = kept;
+                double_nots++;
+                i += 2;
+                continue;
+            }
+        }
+
+        instructions[kept] = instructions[i];
+        lines[kept] = lines[i];
+        label_operands[kept++] = label_operands[i];
+        i++;
+    }
+
+    relocation[count] = kept;
+
+    if (kept < count)
+    {
+        for (i = 0; i < kept; ++i)
+        {
+            mima_instruction instruction = mima_optimizer_decode(instructions[i]);
+
+            if (label_operands[i] && instruction.value <= count)
+            {
+                mima_assemble_instruction(&instructions[i], instruction.op_code, relocation[instruction.value], lines[i]);
+            }
+        }
+
+        for (uint32_t j = 0; j < labels_count; ++j)
+        {
+            if (mima_labels[j].address <= count)
+            {
+                mima_labels[j].address = relocation[mima_labels[j].address];
+            }
+        }
+
+        mima_labels_generation++;
+    }
+
+    log_info("Optimizer saved %zu of %zu instruction(s): %u STV/LDV, %u LDC 0/ADD, %u NOT/NOT.",
+             count - kept, count, store_loads, zero_adds, double_nots);
+
+    free(labeled);
+
+    return kept;
+}
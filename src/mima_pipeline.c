@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mima_pipeline.h"
+#include "log.h"
+
+#define MIMA_PIPELINE_STAGES 3
+
+mima_pipeline *mima_pipeline_create(mima_bool forwarding)
+{
+    mima_pipeline *pipeline = calloc(1, sizeof(mima_pipeline));
+
+    if (!pipeline)
+    {
+        log_error("Could not allocate the pipeline model :(");
+        return NULL;
+    }
+
+    pipeline->forwarding = forwarding;
+    return pipeline;
+}
+
+void mima_pipeline_delete(mima_pipeline *pipeline)
+{
+    free(pipeline);
+}
+
+static mima_bool mima_pipeline_reads_acc(mima_instruction_type op_code)
+{
+    switch (op_code)
+    {
+    case ADD:
+    case AND:
+    case OR:
+    case XOR:
+    case EQL:
+    case STV:
+    case JMN:
+    case NOT:
+    case RAR:
+    case RRN:
+    case MUL:
+    case SUB:
+    case SHL:
+    case SHR:
+    case STIV:
+        return mima_true;
+    default:
+        return mima_false;
+    }
+}
+
+static mima_bool mima_pipeline_writes_acc(mima_instruction_type op_code)
+{
+    switch (op_code)
+    {
+    case ADD:
+    case AND:
+    case OR:
+    case XOR:
+    case EQL:
+    case LDV:
+    case LDC:
+    case NOT:
+    case RAR:
+    case RRN:
+    case MUL:
+    case SUB:
+    case SHL:
+    case SHR:
+    case LDIV:
+        return mima_true;
+    default:
+        return mima_false;
+    }
+}
+
+static mima_bool mima_pipeline_reads_memory(mima_instruction_type op_code)
+{
+    switch (op_code)
+    {
+    case ADD:
+    case AND:
+    case OR:
+    case XOR:
+    case EQL:
+    case LDV:
+    case MUL:
+    case SUB:
+    case LDIV:
+    case STIV:
+        return mima_true;
+    default:
+        return mima_false;
+    }
+}
+
+void mima_pipeline_retire(mima_pipeline *pipeline, mima_t *mima)
+{
+    mima_instruction_type op_code = mima->current_instruction.op_code;
+    mima_register address = mima->current_instruction.value;
+
+    // the first instruction fills the pipeline, every further one adds a cycle
+    pipeline->cycles += pipeline->instructions == 0 ? MIMA_PIPELINE_STAGES : 1;
+    pipeline->instructions++;
+
+    if (mima_pipeline_reads_acc(op_code) && pipeline->previous_writes_acc && !pipeline->forwarding)
+    {
+        pipeline->acc_stalls++;
+        pipeline->cycles++;
+    }
+    // a stall already lets the store finish
+    else if (mima_pipeline_reads_memory(op_code) && pipeline->previous_stores && pipeline->previous_store_address == address)
+    {
+        pipeline->memory_stalls++;
+        pipeline->cycles++;
+    }
+
+    // CALL knows its target in OF, RET reads it from the stack in EX
+    if (op_code == JMP || op_code == CALL)
+    {
+        pipeline->jumps++;
+        pipeline->flushes++;
+        pipeline->cycles += 1;
+    }
+    else if (op_code == RET)
+    {
+        pipeline->jumps++;
+        pipeline->flushes++;
+        pipeline->cycles += 2;
+    }
+    else if (op_code == JMN)
+    {
+        pipeline->branches++;
+
+        // JMN does not change ACC, so this is the decision it just made
+        if ((int32_t)mima->processing_unit.ACC < 0)
+        {
+            pipeline->branches_taken++;
+            pipeline->flushes++;
+            pipeline->cycles += 2;
+        }
+    }
+
+    pipeline->previous_writes_acc = mima_pipeline_writes_acc(op_code);
+    pipeline->previous_stores = op_code == STV || op_code == CALL;
+    pipeline->previous_store_address = op_code == CALL ? mima->control_unit.SP : address;
+}
+
+void mima_pipeline_print_stats(mima_pipeline *pipeline)
+{
+    double instructions = pipeline->instructions ? pipeline->instructions : 1;
+
+    printf("\n");
+    printf("=======PIPELINE==========\n");
+    printf(" MODEL\t    = IF/OF/EX, %s\n", pipeline->forwarding ? "forwarding" : "no forwarding");
+    printf(" INSTR\t    = %llu\n", (unsigned long long)pipeline->instructions);
+    printf(" CYCLES\t    = %llu\n", (unsigned long long)pipeline->cycles);
+    printf(" CPI\t    = %.3f\n", pipeline->cycles / instructions);
+    printf(" ACC STALL   = %llu\n", (unsigned long long)pipeline->acc_stalls);
+    printf(" MEM STALL   = %llu\n", (unsigned long long)pipeline->memory_stalls);
+    printf(" FLUSHES    = %llu (%llu JMP/CALL/RET, %llu of %llu JMN taken)\n", (unsigned long long)pipeline->flushes, (unsigned long long)pipeline->jumps,
+           (unsigned long long)pipeline->branches_taken, (unsigned long long)pipeline->branches);
+    printf(" SPEEDUP    = %.2fx over %d unpipelined cycles per instruction\n", pipeline->cycles ? MIMA_PIPELINE_STAGES * instructions / pipeline->cycles : 0.0, MIMA_PIPELINE_STAGES);
+    printf("=========================\n");
+}
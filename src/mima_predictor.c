@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mima_predictor.h"
+#include "log.h"
+
+#define MIMA_PREDICTOR_DEFAULT_BITS 12
+#define MIMA_PREDICTOR_MAX_BITS 24
+#define MIMA_PREDICTOR_STATS_INITIAL_CAPACITY 256
+
+static const char *predictor_names[] = { "static", "1bit", "2bit", "gshare" };
+
+mima_predictor *mima_predictor_create(const char *config)
+{
+    char name[16] = {0};
+    uint32_t bits = MIMA_PREDICTOR_DEFAULT_BITS;
+
+    sscanf(config, "%15[^,],%u", name, &bits);
+
+    int type = -1;
+
+    for (int i = 0; i < (int)(sizeof(predictor_names) / sizeof(predictor_names[0])); ++i)
+    {
+        if (strcmp(name, predictor_names[i]) == 0)
+        {
+            type = i;
+        }
+    }
+
+    if (type < 0 || bits == 0 || bits > MIMA_PREDICTOR_MAX_BITS)
+    {
+        log_error("Expected static|1bit|2bit|gshare[,bits] with 1 - %d bits, got %s", MIMA_PREDICTOR_MAX_BITS, config);
+        return NULL;
+    }
+
+    mima_predictor *predictor = calloc(1, sizeof(mima_predictor));
+
+    if (!predictor)
+    {
+        log_error("Could not allocate the branch predictor :(");
+        return NULL;
+    }
+
+    predictor->type = type;
+    predictor->bits = bits;
+    predictor->table = calloc((size_t)1 << bits, sizeof(uint8_t));
+    predictor->stats_capacity = MIMA_PREDICTOR_STATS_INITIAL_CAPACITY;
+    predictor->stats = calloc(predictor->stats_capacity, sizeof(mima_branch_stats));
+
+    if (!predictor->table || !predictor->stats)
+    {
+        log_error("Could not allocate the branch predictor :(");
+        mima_predictor_delete(predictor);
+        return NULL;
+    }
+
+    // counters start weakly not taken
+    if (type == MIMA_PREDICTOR_TWO_BIT || type == MIMA_PREDICTOR_GSHARE)
+    {
+        memset(predictor->table, 1, (size_t)1 << bits);
+    }
+
+    return predictor;
+}
+
+void mima_predictor_delete(mima_predictor *predictor)
+{
+    if (!predictor)
+    {
+        return;
+    }
+
+    free(predictor->table);
+    free(predictor->stats);
+    free(predictor);
+}
+
+static mima_branch_stats *mima_predictor_stats_slot(mima_branch_stats *stats, uint32_t capacity, mima_register address)
+{
+    uint32_t index = (uint32_t)((address * 2654435761u) & (capacity - 1));
+
+    while (stats[index].address != 0 && stats[index].address != address + 1)
+    {
+        index = (index + 1) & (capacity - 1);
+    }
+
+    return &stats[index];
+}
+
+static mima_branch_stats *mima_predictor_branch_stats(mima_predictor *predictor, mima_register address)
+{
+    // keep the table at most half full
+    if (2 * (predictor->stats_count + 1) > predictor->stats_capacity)
+    {
+        uint32_t capacity = predictor->stats_capacity * 2;
+        mima_branch_stats *stats = calloc(capacity, sizeof(mima_branch_stats));
+
+        if (stats)
+        {
+            for (uint32_t i = 0; i < predictor->stats_capacity; ++i)
+            {
+                if (predictor->stats[i].address != 0)
+                {
+                    *mima_predictor_stats_slot(stats, capacity, predictor->stats[i].address - 1) = predictor->stats[i];
+                }
+            }
+
+            free(predictor->stats);
+            predictor->stats = stats;
+            predictor->stats_capacity = capacity;
+        }
+        else if (predictor->stats_count + 1 >= predictor->stats_capacity)
+        {
+            // no room left, only the aggregate numbers are kept
+            return NULL;
+        }
+    }
+
+    mima_branch_stats *branch = mima_predictor_stats_slot(predictor->stats, predictor->stats_capacity, address);
+
+    if (branch->address == 0)
+    {
+        branch->address = address + 1;
+        predictor->stats_count++;
+    }
+
+    return branch;
+}
+
+mima_bool mima_predictor_update(mima_predictor *predictor, mima_register address, mima_register target, mima_bool taken)
+{
+    uint32_t mask = (1u << predictor->bits) - 1;
+    uint32_t index = address & mask;
+    mima_bool prediction;
+
+    switch (predictor->type)
+    {
+    case MIMA_PREDICTOR_STATIC:
+        prediction = target <= address;
+        break;
+    case MIMA_PREDICTOR_ONE_BIT:
+        prediction = predictor->table[index];
+        predictor->table[index] = taken;
+        break;
+    case MIMA_PREDICTOR_GSHARE:
+        index = (address ^ predictor->history) & mask;
+        predictor->history = ((predictor->history << 1) | taken) & mask;
+        // fall through
+    case MIMA_PREDICTOR_TWO_BIT:
+    default:
+    {
+        uint8_t *counter = &predictor->table[index];
+        prediction = *counter >= 2;
+
+        if (taken && *counter < 3)
+        {
+            (*counter)++;
+        }
+        else if (!taken && *counter > 0)
+        {
+            (*counter)--;
+        }
+        break;
+    }
+    }
+
+    mima_bool mispredicted = prediction != taken;
+
+    predictor->branches++;
+    predictor->mispredictions += mispredicted;
+
+    mima_branch_stats *branch = mima_predictor_branch_stats(predictor, address);
+
+    if (branch)
+    {
+        branch->executions++;
+        branch->taken += taken;
+        branch->mispredictions += mispredicted;
+    }
+
+    return mispredicted;
+}
+
+static int mima_predictor_compare_stats(const void *a, const void *b)
+{
+    const mima_branch_stats *left = a;
+    const mima_branch_stats *right = b;
+
+    if (left->mispredictions != right->mispredictions)
+    {
+        return left->mispredictions < right->mispredictions ? 1 : -1;
+    }
+
+    return left->address < right->address ? -1 : left->address > right->address;
+}
+
+void mima_predictor_print_stats(mima_predictor *predictor, uint32_t count)
+{
+    printf("\n");
+    printf("=======BRANCHES==========\n");
+    if (predictor->type == MIMA_PREDICTOR_STATIC)
+    {
+        printf(" MODEL\t    = static, backward taken\n");
+    }
+    else
+    {
+        printf(" MODEL\t    = %s, %u bits\n", predictor_names[predictor->type], predictor->bits);
+    }
+
+    printf(" JMN\t    = %llu (%llu mispredicted)\n", (unsigned long long)predictor->branches, (unsigned long long)predictor->mispredictions);
+    printf(" MISS RATE   = %.2f%%\n", predictor->branches ? 100.0 * predictor->mispredictions / predictor->branches : 0.0);
+
+    if (count > 0 && predictor->stats_count > 0)
+    {
+        mima_branch_stats *sorted = malloc(predictor->stats_count * sizeof(mima_branch_stats));
+
+        if (sorted)
+        {
+            uint32_t used = 0;
+
+            for (uint32_t i = 0; i < predictor->stats_capacity; ++i)
+            {
+                if (predictor->stats[i].address != 0)
+                {
+                    sorted[used++] = predictor->stats[i];
+                }
+            }
+
+            qsort(sorted, used, sizeof(mima_branch_stats), mima_predictor_compare_stats);
+
+            printf(" ADDRESS         EXEC   TAKEN  ACCURACY\n");
+
+            for (uint32_t i = 0; i < used && i < count; ++i)
+            {
+                printf("  0x%08x %10llu  %5.1f%%   %5.1f%%\n", sorted[i].address - 1, (unsigned long long)sorted[i].executions,
+                       100.0 * sorted[i].taken / sorted[i].executions, 100.0 * (sorted[i].executions - sorted[i].mispredictions) / sorted[i].executions);
+            }
+
+            free(sorted);
+        }
+    }
+
+    printf("=========================\n");
+}
@@ -0,0 +1,727 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "mima_preprocessor.h"
+#include "log.h"
+
+static const char mima_preprocessor_magic[] = "MIMAPP2";
+
+typedef struct _mima_macro
+{
+    char			name[32];
+    char			params[MIMA_PREPROCESSOR_MAX_PARAMS][32];
+    uint32_t		params_count;
+    char			*body;
+    size_t			body_size;
+} mima_macro;
+
+// a file the expansion was read from
+typedef struct _mima_dependency
+{
+    char			path[PATH_MAX];
+    uint64_t		hash;
+    uint64_t		size;
+    uint64_t		mtime;			// nanoseconds
+} mima_dependency;
+
+typedef struct _mima_preprocessor
+{
+    char			*output;
+    size_t			output_size;
+    size_t			output_capacity;
+
+    mima_macro		*macros;
+    uint32_t		macros_count;
+    uint32_t		macros_capacity;
+    mima_macro		*definition;	// macro whose body is being read
+
+    mima_dependency	*dependencies;
+    uint32_t		dependencies_count;
+    uint32_t		dependencies_capacity;
+
+    uint32_t		expansions;
+    size_t			errors;
+
+    // "#line 12 "file"" tells the assembler where the following lines came from
+    char			marker_file[PATH_MAX];
+    size_t			marker_line;	// line the assembler attributes the next output line to
+    size_t			macro_line;		// line of the outermost macro call, its expansion is attributed to it
+} mima_preprocessor;
+
+static mima_bool cache_enabled = mima_true;
+static char cache_directory[PATH_MAX] = {0};
+
+void mima_preprocessor_set_cache(const char *directory)
+{
+    cache_enabled = directory != NULL;
+    snprintf(cache_directory, sizeof(cache_directory), "%s", directory ? directory : "");
+}
+
+// FNV-1a
+static uint64_t mima_preprocessor_hash(const char *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= (uint8_t)data[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static void mima_preprocessor_reserve(void **array, uint32_t count, uint32_t *capacity, size_t element_size)
+{
+    if (count + 1 <= *capacity)
+    {
+        return;
+    }
+
+    *capacity = *capacity ? *capacity * 2 : 8;
+    *array = realloc(*array, *capacity * element_size);
+
+    if (!*array)
+    {
+        log_fatal("Could not allocate memory for the preprocessor :(");
+        abort();
+    }
+}
+
+static void mima_preprocessor_emit(mima_preprocessor *pp, const char *data, size_t size)
+{
+    if (pp->output_size + size + 1 > pp->output_capacity)
+    {
+        while (pp->output_size + size + 1 > pp->output_capacity)
+        {
+            pp->output_capacity = pp->output_capacity ? pp->output_capacity * 2 : 4096;
+        }
+
+        pp->output = realloc(pp->output, pp->output_capacity);
+
+        if (!pp->output)
+        {
+            log_fatal("Could not allocate memory for the preprocessor :(");
+            abort();
+        }
+    }
+
+    memcpy(&pp->output[pp->output_size], data, size);
+    pp->output_size += size;
+}
+
+static char *mima_preprocessor_read_file(const char *file_name, size_t *size)
+{
+    FILE *file = fopen(file_name, "rb");
+
+    if (!file)
+    {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *data = length >= 0 ? malloc(length + 1) : NULL;
+
+    if (!data || fread(data, 1, length, file) != (size_t)length)
+    {
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    data[length] = 0;
+    *size = length;
+    return data;
+}
+
+// size and modification time of a file, 0 if it is gone
+static uint64_t mima_preprocessor_stat(const char *path, uint64_t *size)
+{
+    struct stat file_stat;
+
+    if (stat(path, &file_stat) != 0)
+    {
+        *size = 0;
+        return 0;
+    }
+
+    *size = file_stat.st_size;
+    return (uint64_t)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+}
+
+static void mima_preprocessor_push_dependency(mima_preprocessor *pp, const char *path, const char *data, size_t size)
+{
+    mima_preprocessor_reserve((void **)&pp->dependencies, pp->dependencies_count, &pp->dependencies_capacity, sizeof(mima_dependency));
+
+    mima_dependency *dependency = &pp->dependencies[pp->dependencies_count++];
+    snprintf(dependency->path, sizeof(dependency->path), "%s", path);
+    dependency->hash = mima_preprocessor_hash(data, size);
+    dependency->mtime = mima_preprocessor_stat(path, &dependency->size);
+}
+
+static void mima_preprocessor_mark(mima_preprocessor *pp, const char *file_name, size_t line_number)
+{
+    if (pp->marker_line != line_number || strcmp(pp->marker_file, file_name) != 0)
+    {
+        char marker[PATH_MAX + 32];
+        int length = snprintf(marker, sizeof(marker), "#line %zu \"%s\"\n", line_number, file_name);
+        mima_preprocessor_emit(pp, marker, length < (int)sizeof(marker) ? (size_t)length : sizeof(marker) - 1);
+        snprintf(pp->marker_file, sizeof(pp->marker_file), "%s", file_name);
+    }
+
+    pp->marker_line = line_number + 1;
+}
+
+static mima_macro *mima_preprocessor_find_macro(mima_preprocessor *pp, const char *name)
+{
+    for (uint32_t i = 0; i < pp->macros_count; ++i)
+    {
+        if (strcmp(pp->macros[i].name, name) == 0)
+        {
+            return &pp->macros[i];
+        }
+    }
+
+    return NULL;
+}
+
+static mima_bool mima_preprocessor_is_comment(const char *token)
+{
+    return token == NULL || strncmp(token, "//", 2) == 0 || token[0] == '#';
+}
+
+static mima_bool mima_preprocessor_is_identifier(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static void mima_preprocessor_buffer(mima_preprocessor *pp, const char *file_name, const char *source, size_t size, uint32_t depth);
+
+static void mima_preprocessor_include(mima_preprocessor *pp, const char *file_name, size_t line_number, const char *argument, uint32_t depth)
+{
+    char name[PATH_MAX];
+    size_t length = strlen(argument);
+
+    // quotes are optional
+    if (length >= 2 && argument[0] == '"' && argument[length - 1] == '"')
+    {
+        argument++;
+        length -= 2;
+    }
+
+    // relative to the including file
+    const char *slash = strrchr(file_name, '/');
+    int directory_length = argument[0] != '/' && slash ? (int)(slash - file_name + 1) : 0;
+    snprintf(name, sizeof(name), "%.*s%.*s", directory_length, file_name, (int)length, argument);
+
+    char path[PATH_MAX];
+
+    if (!realpath(name, path))
+    {
+        log_error("%s:%zu: Cannot include %s :(", file_name, line_number, name);
+        pp->errors++;
+        return;
+    }
+
+    // libraries shared by several includes are only assembled once
+    for (uint32_t i = 0; i < pp->dependencies_count; ++i)
+    {
+        if (strcmp(pp->dependencies[i].path, path) == 0)
+        {
+            log_trace("%s:%zu: %s is already included", file_name, line_number, name);
+            return;
+        }
+    }
+
+    size_t include_size;
+    char *include = mima_preprocessor_read_file(path, &include_size);
+
+    if (!include)
+    {
+        log_error("%s:%zu: Failed to read %s :(", file_name, line_number, name);
+        pp->errors++;
+        return;
+    }
+
+    // an include inside of a macro has lines of its own
+    size_t macro_line = pp->macro_line;
+    pp->macro_line = 0;
+
+    mima_preprocessor_push_dependency(pp, path, include, include_size);
+    mima_preprocessor_buffer(pp, name, include, include_size, depth + 1);
+    free(include);
+
+    pp->macro_line = macro_line;
+}
+
+static void mima_preprocessor_define(mima_preprocessor *pp, const char *file_name, size_t line_number, char **save)
+{
+    char *name = strtok_r(NULL, " \t,\r\n", save);
+
+    if (mima_preprocessor_is_comment(name) || strlen(name) > 31 || name[0] == '.' || name[0] == ':')
+    {
+        log_error("%s:%zu: .macro expects a name.", file_name, line_number);
+        pp->errors++;
+        name = NULL;
+    }
+    else if (mima_preprocessor_find_macro(pp, name))
+    {
+        log_error("%s:%zu: Macro %s is already defined.", file_name, line_number, name);
+        pp->errors++;
+        name = NULL;
+    }
+
+    mima_preprocessor_reserve((void **)&pp->macros, pp->macros_count, &pp->macros_capacity, sizeof(mima_macro));
+
+    // an invalid macro is still read up to its .endm, it just cannot be used
+    mima_macro *macro = &pp->macros[pp->macros_count++];
+    memset(macro, 0, sizeof(mima_macro));
+    snprintf(macro->name, sizeof(macro->name), "%s", name ? name : "");
+    pp->definition = macro;
+
+    char *param;
+    while (!mima_preprocessor_is_comment(param = strtok_r(NULL, " \t,\r\n", save)))
+    {
+        if (macro->params_count == MIMA_PREPROCESSOR_MAX_PARAMS || strlen(param) > 31)
+        {
+            log_error("%s:%zu: Too many or too long parameters for macro %s.", file_name, line_number, macro->name);
+            pp->errors++;
+            break;
+        }
+
+        snprintf(macro->params[macro->params_count++], 32, "%s", param);
+    }
+}
+
+static void mima_preprocessor_expand(mima_preprocessor *pp, mima_macro *macro, const char *file_name, size_t line_number, char **save, uint32_t depth)
+{
+    const char *args[MIMA_PREPROCESSOR_MAX_PARAMS];
+    uint32_t args_count = 0;
+
+    char *arg;
+    while (!mima_preprocessor_is_comment(arg = strtok_r(NULL, " \t,\r\n", save)))
+    {
+        if (args_count == MIMA_PREPROCESSOR_MAX_PARAMS)
+        {
+            args_count++;
+            break;
+        }
+
+        args[args_count++] = arg;
+    }
+
+    if (args_count != macro->params_count)
+    {
+        log_error("%s:%zu: Macro %s expects %u argument(s).", file_name, line_number, macro->name, macro->params_count);
+        pp->errors++;
+        return;
+    }
+
+    // substitute into a buffer of its own, which is preprocessed again for nested macros
+    mima_preprocessor body = {0};
+    const char *cursor = macro->body;
+    const char *end = macro->body + macro->body_size;
+    char unique[16];
+    snprintf(unique, sizeof(unique), "%u", pp->expansions++);
+
+    while (cursor < end)
+    {
+        const char *backslash = memchr(cursor, '\\', end - cursor);
+
+        if (!backslash)
+        {
+            mima_preprocessor_emit(&body, cursor, end - cursor);
+            break;
+        }
+
+        mima_preprocessor_emit(&body, cursor, backslash - cursor);
+        cursor = backslash + 1;
+
+        if (cursor < end && *cursor == '@')
+        {
+            mima_preprocessor_emit(&body, unique, strlen(unique));
+            cursor++;
+            continue;
+        }
+
+        const char *identifier = cursor;
+        while (cursor < end && mima_preprocessor_is_identifier(*cursor))
+        {
+            cursor++;
+        }
+
+        size_t length = cursor - identifier;
+        uint32_t i = 0;
+        while (i < macro->params_count && (strlen(macro->params[i]) != length || strncmp(macro->params[i], identifier, length) != 0))
+        {
+            i++;
+        }
+
+        if (i == macro->params_count)
+        {
+            log_error("%s:%zu: Macro %s has no parameter \\%.*s.", file_name, line_number, macro->name, (int)length, identifier);
+            pp->errors++;
+            continue;
+        }
+
+        mima_preprocessor_emit(&body, args[i], strlen(args[i]));
+    }
+
+    mima_bool outermost = pp->macro_line == 0;
+
+    if (outermost)
+    {
+        pp->macro_line = line_number;
+    }
+
+    mima_preprocessor_buffer(pp, file_name, body.output, body.output_size, depth + 1);
+    free(body.output);
+
+    if (outermost)
+    {
+        pp->macro_line = 0;
+    }
+}
+
+static void mima_preprocessor_buffer(mima_preprocessor *pp, const char *file_name, const char *source, size_t size, uint32_t depth)
+{
+    if (depth > MIMA_PREPROCESSOR_MAX_DEPTH)
+    {
+        log_error("%s: Includes or macros are nested deeper than %d levels.", file_name, MIMA_PREPROCESSOR_MAX_DEPTH);
+        pp->errors++;
+        return;
+    }
+
+    const char *cursor = source;
+    const char *end = source + size;
+    size_t buffer_line = 0;
+
+    while (cursor < end)
+    {
+        const char *newline = memchr(cursor, '\n', end - cursor);
+        const char *line_end = newline ? newline + 1 : end;
+        size_t length = line_end - cursor;
+        size_t line_number = pp->macro_line ? pp->macro_line : ++buffer_line;
+
+        // the assembler reads 255 chars per line anyway
+        char line[256];
+        size_t copy = length < sizeof(line) - 1 ? length : sizeof(line) - 1;
+        memcpy(line, cursor, copy);
+        line[copy] = 0;
+
+        char *save = NULL;
+        char *token = strtok_r(line, " \t\r\n", &save);
+
+        if (pp->definition)
+        {
+            if (token && strcmp(token, ".endm") == 0)
+            {
+                pp->definition = NULL;
+            }
+            else if (token && strcmp(token, ".macro") == 0)
+            {
+                log_error("%s:%zu: Macros cannot be defined inside of %s.", file_name, line_number, pp->definition->name);
+                pp->errors++;
+            }
+            else
+            {
+                mima_macro *macro = pp->definition;
+                macro->body = realloc(macro->body, macro->body_size + length + 1);
+
+                if (!macro->body)
+                {
+                    log_fatal("Could not allocate memory for macro %s :(", macro->name);
+                    abort();
+                }
+
+                memcpy(&macro->body[macro->body_size], cursor, length);
+                macro->body_size += length;
+
+                if (!newline)
+                {
+                    macro->body[macro->body_size++] = '\n';
+                }
+            }
+        }
+        else if (token && strcmp(token, ".include") == 0)
+        {
+            char *argument = strtok_r(NULL, " \t\r\n", &save);
+
+            if (mima_preprocessor_is_comment(argument))
+            {
+                log_error("%s:%zu: .include expects a file name.", file_name, line_number);
+                pp->errors++;
+            }
+            else
+            {
+                mima_preprocessor_include(pp, file_name, line_number, argument, depth);
+            }
+        }
+        else if (token && strcmp(token, ".macro") == 0)
+        {
+            mima_preprocessor_define(pp, file_name, line_number, &save);
+        }
+        else if (token && strcmp(token, ".endm") == 0)
+        {
+            log_error("%s:%zu: .endm without .macro.", file_name, line_number);
+            pp->errors++;
+        }
+        else if (token && token[0] && mima_preprocessor_find_macro(pp, token))
+        {
+            mima_preprocessor_expand(pp, mima_preprocessor_find_macro(pp, token), file_name, line_number, &save, depth);
+        }
+        else
+        {
+            // everything else is the assemblers business
+            mima_preprocessor_mark(pp, file_name, line_number);
+            mima_preprocessor_emit(pp, cursor, length);
+
+            if (!newline)
+            {
+                mima_preprocessor_emit(pp, "\n", 1);
+            }
+        }
+
+        cursor = line_end;
+    }
+
+    if (depth == 0 && pp->definition)
+    {
+        log_error("%s: Macro %s is missing its .endm.", file_name, pp->definition->name);
+        pp->errors++;
+        pp->definition = NULL;
+    }
+}
+
+// files without a single .include or .macro are assembled straight from the mapping
+static mima_bool mima_preprocessor_has_directives(const char *source, size_t size)
+{
+    const char *cursor = source;
+    const char *end = source + size;
+
+    while (cursor < end)
+    {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+        {
+            cursor++;
+        }
+
+        size_t length = end - cursor;
+
+        if ((length >= 8 && strncmp(cursor, ".include", 8) == 0) || (length >= 6 && strncmp(cursor, ".macro", 6) == 0))
+        {
+            return mima_true;
+        }
+
+        const char *newline = memchr(cursor, '\n', length);
+        cursor = newline ? newline + 1 : end;
+    }
+
+    return mima_false;
+}
+
+static mima_bool mima_preprocessor_cache_path(const char *path, char *cache_path, size_t size)
+{
+    char directory[PATH_MAX];
+
+    if (cache_directory[0])
+    {
+        snprintf(directory, sizeof(directory), "%s", cache_directory);
+    }
+    else
+    {
+        const char *slash = strrchr(path, '/');
+        snprintf(directory, sizeof(directory), "%.*s/.mima_cache", (int)(slash - path), path);
+    }
+
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST)
+    {
+        log_warn("Cannot create the cache directory %s, preprocessing without cache.", directory);
+        return mima_false;
+    }
+
+    // one entry per translation unit
+    int length = snprintf(cache_path, size, "%s/%016" PRIx64 ".i", directory, mima_preprocessor_hash(path, strlen(path)));
+
+    if (length < 0 || (size_t)length >= size)
+    {
+        log_warn("The cache path in %s is too long, preprocessing without cache.", directory);
+        return mima_false;
+    }
+
+    return mima_true;
+}
+
+// "MIMAPP2 dependencies size\n", one "hash size mtime path\n" line per dependency, then the expansion
+static mima_bool mima_preprocessor_cache_load(const char *cache_path, char **expanded, size_t *expanded_size)
+{
+    FILE *file = fopen(cache_path, "rb");
+
+    if (!file)
+    {
+        return mima_false;
+    }
+
+    char magic[8];
+    uint32_t dependencies_count;
+    size_t size;
+
+    if (fscanf(file, "%7s %u %zu", magic, &dependencies_count, &size) != 3 || strcmp(magic, mima_preprocessor_magic) != 0 || fgetc(file) != '\n')
+    {
+        fclose(file);
+        return mima_false;
+    }
+
+    for (uint32_t i = 0; i < dependencies_count; ++i)
+    {
+        uint64_t hash;
+        uint64_t size_then;
+        uint64_t mtime_then;
+        char path[PATH_MAX];
+
+        if (fscanf(file, "%" SCNx64 " %" SCNu64 " %" SCNu64 " ", &hash, &size_then, &mtime_then) != 3 || !fgets(path, sizeof(path), file))
+        {
+            fclose(file);
+            return mima_false;
+        }
+
+        path[strcspn(path, "\n")] = 0;
+
+        // a file with the same size and modification time is not read at all
+        uint64_t size_now;
+        uint64_t mtime_now = mima_preprocessor_stat(path, &size_now);
+        mima_bool unchanged = mtime_now != 0 && size_now == size_then && mtime_now == mtime_then;
+
+        if (!unchanged && mtime_now != 0)
+        {
+            // touched, but maybe not changed
+            size_t dependency_size;
+            char *dependency = mima_preprocessor_read_file(path, &dependency_size);
+            unchanged = dependency && mima_preprocessor_hash(dependency, dependency_size) == hash;
+            free(dependency);
+        }
+
+        if (!unchanged)
+        {
+            log_info("%s changed, preprocessing again ...", path);
+            fclose(file);
+            return mima_false;
+        }
+    }
+
+    *expanded = malloc(size + 1);
+
+    if (!*expanded || fread(*expanded, 1, size, file) != size)
+    {
+        free(*expanded);
+        *expanded = NULL;
+        fclose(file);
+        return mima_false;
+    }
+
+    fclose(file);
+    *expanded_size = size;
+    return mima_true;
+}
+
+static void mima_preprocessor_cache_store(mima_preprocessor *pp, const char *cache_path)
+{
+    char temporary[PATH_MAX + 8];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", cache_path);
+
+    FILE *file = fopen(temporary, "wb");
+
+    if (!file)
+    {
+        log_warn("Cannot write the cache entry %s.", temporary);
+        return;
+    }
+
+    fprintf(file, "%s %u %zu\n", mima_preprocessor_magic, pp->dependencies_count, pp->output_size);
+
+    for (uint32_t i = 0; i < pp->dependencies_count; ++i)
+    {
+        mima_dependency *dependency = &pp->dependencies[i];
+        fprintf(file, "%016" PRIx64 " %" PRIu64 " %" PRIu64 " %s\n", dependency->hash, dependency->size, dependency->mtime, dependency->path);
+    }
+
+    mima_bool written = fwrite(pp->output, 1, pp->output_size, file) == pp->output_size;
+
+    // rename() is atomic, a concurrent build never reads half an entry
+    if (fclose(file) != 0 || !written || rename(temporary, cache_path) != 0)
+    {
+        log_warn("Cannot write the cache entry %s.", cache_path);
+        remove(temporary);
+    }
+}
+
+mima_bool mima_preprocess_source(const char *file_name, const char *source, size_t size, char **expanded, size_t *expanded_size)
+{
+    *expanded = NULL;
+    *expanded_size = 0;
+
+    if (!mima_preprocessor_has_directives(source, size))
+    {
+        return mima_true;
+    }
+
+    char path[PATH_MAX];
+    char cache_path[PATH_MAX];
+
+    if (!realpath(file_name, path))
+    {
+        log_error("Failed to resolve %s :(", file_name);
+        return mima_false;
+    }
+
+    mima_bool cached = cache_enabled && mima_preprocessor_cache_path(path, cache_path, sizeof(cache_path));
+
+    if (cached && mima_preprocessor_cache_load(cache_path, expanded, expanded_size))
+    {
+        log_info("Using the cached expansion of %s.", file_name);
+        return mima_true;
+    }
+
+    mima_preprocessor pp = {0};
+    mima_preprocessor_push_dependency(&pp, path, source, size);
+    mima_preprocessor_buffer(&pp, file_name, source, size, 0);
+
+    for (uint32_t i = 0; i < pp.macros_count; ++i)
+    {
+        free(pp.macros[i].body);
+    }
+
+    free(pp.macros);
+
+    if (pp.errors > 0)
+    {
+        log_error("Found %zu error(s) while preprocessing %s.", pp.errors, file_name);
+        free(pp.dependencies);
+        free(pp.output);
+        return mima_false;
+    }
+
+    log_info("Preprocessed %s: %u file(s), %u macro expansion(s).", file_name, pp.dependencies_count, pp.expansions);
+
+    if (cached)
+    {
+        mima_preprocessor_cache_store(&pp, cache_path);
+    }
+
+    free(pp.dependencies);
+
+    // never NULL, even for an empty expansion
+    mima_preprocessor_emit(&pp, "", 0);
+    *expanded = pp.output;
+    *expanded_size = pp.output_size;
+    return mima_true;
+}
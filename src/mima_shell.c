@@ -1,8 +1,21 @@
 #include <string.h>
 #include <stdlib.h>
 #include "mima_shell.h"
+#include "mima_compiler.h"
+#include "mima_memory.h"
+#include "mima_memscan.h"
+#include "mima_devices.h"
+#include "mima_timing.h"
+#include "mima_pipeline.h"
+#include "mima_cache.h"
+#include "mima_predictor.h"
+#include "mima_analysis.h"
+#include "mima_watchdog.h"
+#include "mima_interrupts.h"
 #include "log.h"
 
+static mima_bool batch_mode = mima_false;
+
 void mima_shell_print_help()
 {
     printf("\n=====================\n mima_shell commands \n=====================\n");
@@ -16,11 +29,32 @@ void mima_shell_print_help()
     printf(" i [addr]......sets the IAR to address\n");
     printf(" i.............sets the IAR to zero\n");
     printf(" r.............runs program till end or breakpoint\n");
+    printf(" l [file]......reassembles the source, only changed words are rewritten\n");
+    printf(" memdump --dirty [--binary] [file]\n");
+    printf("...............dumps all pages written since the start\n");
+    printf(" memdiff [--binary] [file]\n");
+    printf("...............dumps all words changed since the baseline (end of compilation)\n");
+    printf(" memdiff --reset\n");
+    printf("...............makes the current memory the baseline\n");
+    printf(" find value [addr [#]]\n");
+    printf("...............finds value in # words at address (default: all memory)\n");
+    printf(" fill addr # value\n");
+    printf("...............sets # words at address to value\n");
+    printf(" map file addr [#]\n");
+    printf("...............maps a host file read-only into # words at address\n");
+    printf(" checksum [addr [#]]\n");
+    printf("...............sum and xor of # words at address (default: all memory)\n");
+    printf(" limits [spec].budgets and why the mima stopped, spec = instructions=#,seconds=#,pages=#,output=#\n");
+    printf(" stats.........instructions and cycles per op code (timing and pipeline model)\n");
+    printf(" cache [#].....cache counters and the # addresses with the most misses\n");
+    printf(" branches [#]..predictor accuracy and the # JMN with the most mispredictions\n");
+    printf(" check.........control flow analysis of the assembled program\n");
     printf(" p.............prints mima state\n");
     printf(" L [LOG_LEVEL].sets the log level\n");
     printf(" L.............prints current and available log level\n");
     printf(" q.............quits mima\n");
     printf(" -ENTER-.......repeats last command\n");
+    printf(" cmd;cmd.......runs several commands\n");
     printf("=====================\n");
 }
 
@@ -54,6 +88,17 @@ void mima_shell_print_memory(mima_t *mima, char *arg)
     mima_print_memory_at(mima, address, count);
 }
 
+void mima_shell_reassemble(mima_t *mima, char *arg)
+{
+    // skip the whitespace between command and file name
+    while (*arg == ' ')
+    {
+        arg++;
+    }
+
+    mima_reassemble_file(mima, arg);
+}
+
 void mima_shell_set_log_level(char *arg)
 {
     if (strncmp(arg + 1, "FATAL", 5) == 0)
@@ -88,8 +133,315 @@ void mima_shell_set_log_level(char *arg)
 
 }
 
+// Returns the arguments if input is the given (multi letter) command, NULL otherwise.
+char *mima_shell_match_command(char *input, const char *command)
+{
+    size_t length = strlen(command);
+
+    if (strncmp(input, command, length) != 0 || (input[length] != 0 && input[length] != ' '))
+    {
+        return NULL;
+    }
+
+    input += length;
+
+    while (*input == ' ')
+    {
+        input++;
+    }
+
+    return input;
+}
+
+// Consumes the option if it is the next argument.
+mima_bool mima_shell_take_option(char **arg, const char *option)
+{
+    char *rest = mima_shell_match_command(*arg, option);
+
+    if (!rest)
+    {
+        return mima_false;
+    }
+
+    *arg = rest;
+    return mima_true;
+}
+
+void mima_shell_memory_dump(mima_t *mima, char *arg, mima_bool diff)
+{
+    mima_bool dirty = mima_false;
+    mima_bool binary = mima_false;
+
+    while (*arg == '-')
+    {
+        if (mima_shell_take_option(&arg, "--dirty"))
+        {
+            dirty = mima_true;
+        }
+        else if (mima_shell_take_option(&arg, "--binary"))
+        {
+            binary = mima_true;
+        }
+        else if (diff && mima_shell_take_option(&arg, "--reset"))
+        {
+            mima_memory_reset_baseline(&mima->memory_unit);
+            printf("Current memory is the new baseline.\n");
+            return;
+        }
+        else
+        {
+            printf("Unknown option %s\n", arg);
+            return;
+        }
+    }
+
+    if (!diff && !dirty)
+    {
+        printf("memdump only supports --dirty for now.\n");
+        return;
+    }
+
+    if (binary && *arg == 0)
+    {
+        printf("Binary output needs a file.\n");
+        return;
+    }
+
+    FILE *out = stdout;
+
+    if (*arg != 0)
+    {
+        out = fopen(arg, binary ? "wb" : "w");
+
+        if (!out)
+        {
+            printf("Could not open %s\n", arg);
+            return;
+        }
+    }
+
+    if (diff)
+    {
+        mima_memory_diff(&mima->memory_unit, out, binary);
+    }
+    else
+    {
+        mima_memory_dump_dirty(&mima->memory_unit, out, binary);
+    }
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    else
+    {
+        fflush(stdout);
+    }
+}
+
+// Parses up to max numbers, returns how many were found.
+int mima_shell_parse_numbers(char *arg, uint32_t *numbers, int max)
+{
+    int parsed = 0;
+
+    while (parsed < max)
+    {
+        char *endptr;
+        uint32_t number = strtoul(arg, &endptr, 0);
+
+        if (endptr == arg)
+        {
+            break;
+        }
+
+        numbers[parsed++] = number;
+        arg = endptr;
+    }
+
+    return parsed;
+}
+
+void mima_shell_find(mima_t *mima, char *arg)
+{
+    uint32_t numbers[3] = { 0, 0, mima_words };
+    mima_register matches[16];
+
+    if (mima_shell_parse_numbers(arg, numbers, 3) < 1)
+    {
+        printf("Usage: find value [addr [#]]\n");
+        return;
+    }
+
+    uint32_t found = mima_memory_find(&mima->memory_unit, numbers[1], numbers[2], numbers[0], matches, 16);
+
+    for (uint32_t i = 0; i < found && i < 16; ++i)
+    {
+        printf("mem[0x%08x] = 0x%08x\n", matches[i], numbers[0]);
+    }
+
+    printf("%u match(es)%s (%s)\n", found, found > 16 ? ", showing the first 16" : "", mima_scan_kernel_name());
+}
+
+void mima_shell_fill(mima_t *mima, char *arg)
+{
+    uint32_t numbers[3];
+
+    if (mima_shell_parse_numbers(arg, numbers, 3) < 3)
+    {
+        printf("Usage: fill addr # value\n");
+        return;
+    }
+
+    mima_memory_fill(&mima->memory_unit, numbers[0], numbers[1], numbers[2]);
+}
+
+void mima_shell_checksum(mima_t *mima, char *arg)
+{
+    uint32_t numbers[2] = { 0, mima_words };
+    mima_checksum checksum;
+
+    mima_shell_parse_numbers(arg, numbers, 2);
+    mima_memory_checksum(&mima->memory_unit, numbers[0], numbers[1], &checksum);
+
+    printf("sum = 0x%016llx xor = 0x%08x (%s)\n", (unsigned long long)checksum.sum, checksum.xor, mima_scan_kernel_name());
+}
+
+void mima_shell_map_file(mima_t *mima, char *arg)
+{
+    char *file_name = arg;
+
+    while (*arg != ' ' && *arg != 0)
+    {
+        arg++;
+    }
+
+    uint32_t numbers[2] = { 0, 0 };
+
+    if (*arg == 0 || mima_shell_parse_numbers(arg + 1, numbers, 2) < 1)
+    {
+        printf("Usage: map file addr [#]\n");
+        return;
+    }
+
+    *arg = 0;
+    mima_device_map_file(mima, file_name, numbers[0], numbers[1]);
+}
+
+void mima_shell_cache(mima_t *mima, char *arg)
+{
+    if (!mima->cache)
+    {
+        printf("No cache model, start with --cache size,ways,line[,wb|wt]\n");
+        return;
+    }
+
+    uint32_t count = 10;
+    mima_shell_parse_numbers(arg, &count, 1);
+    mima_cache_print_stats(mima->cache, count);
+}
+
+void mima_shell_branches(mima_t *mima, char *arg)
+{
+    if (!mima->predictor)
+    {
+        printf("No branch predictor, start with --predictor static|1bit|2bit|gshare[,bits]\n");
+        return;
+    }
+
+    uint32_t count = 10;
+    mima_shell_parse_numbers(arg, &count, 1);
+    mima_predictor_print_stats(mima->predictor, count);
+}
+
 int mima_shell_execute_command(mima_t *mima, char *input)
 {
+    char *arg;
+
+    if ((arg = mima_shell_match_command(input, "stats")))
+    {
+        mima_timing_print_stats(mima);
+
+        if (mima->pipeline)
+        {
+            mima_pipeline_print_stats(mima->pipeline);
+        }
+
+        if (mima->cache)
+        {
+            mima_cache_print_stats(mima->cache, 0);
+        }
+
+        if (mima->predictor)
+        {
+            mima_predictor_print_stats(mima->predictor, 0);
+        }
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "limits")))
+    {
+        if (*arg == 0 || mima_watchdog_set(mima, arg))
+        {
+            mima_watchdog_print(mima);
+        }
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "cache")))
+    {
+        mima_shell_cache(mima, arg);
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "branches")))
+    {
+        mima_shell_branches(mima, arg);
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "check")))
+    {
+        mima_analysis_result result = mima_analyze_image();
+        printf("%u error(s), %u warning(s)\n", result.errors, result.warnings);
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "map")))
+    {
+        mima_shell_map_file(mima, arg);
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "find")))
+    {
+        mima_shell_find(mima, arg);
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "fill")))
+    {
+        mima_shell_fill(mima, arg);
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "checksum")))
+    {
+        mima_shell_checksum(mima, arg);
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "memdump")))
+    {
+        mima_shell_memory_dump(mima, arg, mima_false);
+        return 1;
+    }
+
+    if ((arg = mima_shell_match_command(input, "memdiff")))
+    {
+        mima_shell_memory_dump(mima, arg, mima_true);
+        return 1;
+    }
+
     switch(input[0])
     {
     case 's':
@@ -107,10 +459,11 @@ int mima_shell_execute_command(mima_t *mima, char *input)
     case 'r':
     {
 
-        if (mima->current_instruction.op_code == HLT && mima->control_unit.IAR != 0)
+        // scripts run without asking
+        if (!batch_mode && mima->current_instruction.op_code == HLT && mima->control_unit.IAR != 0)
         {
             printf("Last instruction was HLT and IAR != 0. Are you shure you want to run the mima? -> y|N\n\nThis could result in a lot of ADD instructions if you just executed a mima program\nand the IAR points to the end of your defined memory.\nYou can set the IAR (e.g. to zero) with the 'i' command.\n\nBeware: the first run of your program could have modified the mima state or memory.\nThis could result in an endless loop.\n");
-            char res = getchar();
+            char res = mima_input_getchar(mima);
             if (res != 'y')
             {
                 break;
@@ -119,6 +472,13 @@ int mima_shell_execute_command(mima_t *mima, char *input)
 
         mima->control_unit.RUN = mima_true;
 
+        // micro cycle traces are only available in the micro engine
+        if (log_get_level() > LOG_TRACE)
+        {
+            mima_run_fast(mima, UINT64_MAX);
+            break;
+        }
+
         while(mima->control_unit.RUN)
         {
             mima_micro_instruction_step(mima);
@@ -127,6 +487,9 @@ int mima_shell_execute_command(mima_t *mima, char *input)
         }
         break;
     }
+    case 'l':
+        mima_shell_reassemble(mima, input + 1);
+        break;
     case 'L':
         mima_shell_set_log_level(input + 1);
         break;
@@ -145,12 +508,12 @@ int mima_shell_execute_command(mima_t *mima, char *input)
 
 int mima_shell(mima_t *mima)
 {
-    static char last_command[32] = "S";
-    char command[32];
+    static char last_command[256] = "S";
+    char command[256];
     char *input;
 
     printf("\e[1;32mmima_shell>\e[m ");
-    input = fgets(command, 31, stdin);
+    input = mima_input_gets(mima, command, sizeof(command));
 
     if(!input)
     {
@@ -169,5 +532,71 @@ int mima_shell(mima_t *mima)
         strcpy(last_command, input);
     }
 
+    // "S 1000;m 0" runs both
+    if (strchr(input, ';'))
+    {
+        char line[256];
+        strcpy(line, input);
+        return mima_shell_execute_line(mima, line);
+    }
+
     return mima_shell_execute_command(mima, input);
-}
\ No newline at end of file
+}
+
+void mima_shell_set_batch_mode(mima_bool enabled)
+{
+    batch_mode = enabled;
+}
+
+int mima_shell_execute_line(mima_t *mima, char *line)
+{
+    char *save = NULL;
+
+    for (char *command = strtok_r(line, ";\n", &save); command; command = strtok_r(NULL, ";\n", &save))
+    {
+        while (*command == ' ' || *command == '\t')
+        {
+            command++;
+        }
+
+        size_t length = strlen(command);
+        while (length > 0 && (command[length - 1] == ' ' || command[length - 1] == '\r' || command[length - 1] == '\t'))
+        {
+            command[--length] = 0;
+        }
+
+        // skip empty commands and comments, an empty command does not repeat the last one here
+        if (length == 0 || command[0] == '#')
+        {
+            continue;
+        }
+
+        if (!mima_shell_execute_command(mima, command))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int mima_shell_run_script(mima_t *mima, const char *file_name)
+{
+    FILE *file = fopen(file_name, "r");
+
+    if (!file)
+    {
+        log_error("Failed to open shell script: %s :(", file_name);
+        return 0;
+    }
+
+    char line[1024];
+    int result = 1;
+    while (result && fgets(line, sizeof(line), file))
+    {
+        result = mima_shell_execute_line(mima, line);
+    }
+
+    fclose(file);
+    return result;
+}
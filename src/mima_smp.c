@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mima_smp.h"
+#include "mima_watchdog.h"
+#include "log.h"
+
+static uint64_t mima_smp_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Same program, memory and limits, everything else starts over.
+static void mima_smp_init_core(mima_t *core, const mima_t *mima, uint32_t number, uint32_t count)
+{
+    memcpy(core, mima, sizeof(mima_t));
+
+    core->core = number;
+    core->cores = count;
+    core->control_unit.IR = 0;
+    core->control_unit.SP = mima_words - number * MIMA_SMP_STACK_WORDS;
+    core->control_unit.TRA = mima_false;
+    core->control_unit.RUN = mima_true;
+    core->processing_unit.ACC = 0;
+    core->processing_unit.X = 0;
+    core->processing_unit.Y = 0;
+    core->processing_unit.Z = 0;
+    core->processing_unit.MICRO_CYCLE = 1;
+    core->memory_unit.SIR = 0;
+    core->memory_unit.SAR = 0;
+    core->memory_unit.dirty_pages_count = 0;
+    memset(&core->counters, 0, sizeof(core->counters));
+    core->stop_reason = MIMA_STOP_NONE;
+    core->dma.enabled = mima_false;
+    core->interrupts.enabled = mima_false;
+    core->interrupts.due = UINT64_MAX;
+    core->interrupts.input = NULL;
+
+    // the first retired instruction schedules the next check
+    if (core->limits.due != UINT64_MAX)
+    {
+        core->limits.due = 0;
+    }
+
+    // the models are not shared between threads
+    core->pipeline = NULL;
+    core->cache = NULL;
+    core->predictor = NULL;
+    core->io_log = NULL;
+    core->checkpoint = NULL;
+    core->telemetry = NULL;
+}
+
+static void *mima_smp_core(void *argument)
+{
+    mima_run_fast(argument, UINT64_MAX);
+    return NULL;
+}
+
+static void mima_smp_run_threads(mima_t **cores, uint32_t count)
+{
+    pthread_t threads[MIMA_SMP_MAX_CORES];
+    mima_bool started[MIMA_SMP_MAX_CORES] = { mima_false };
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        cores[i]->memory_unit.shared = mima_true;
+    }
+
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        started[i] = pthread_create(&threads[i], NULL, mima_smp_core, cores[i]) == 0;
+
+        if (!started[i])
+        {
+            log_error("Could not start a thread for core %u, it does not run :(", i);
+            cores[i]->control_unit.RUN = mima_false;
+        }
+    }
+
+    // core 0 keeps the calling thread
+    mima_run_fast(cores[0], UINT64_MAX);
+
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        cores[i]->memory_unit.shared = mima_false;
+    }
+}
+
+static void mima_smp_run_round_robin(mima_t **cores, uint32_t count, uint32_t quantum)
+{
+    mima_bool running = mima_true;
+
+    while (running)
+    {
+        running = mima_false;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (cores[i]->control_unit.RUN)
+            {
+                mima_run_fast(cores[i], quantum);
+                running |= cores[i]->control_unit.RUN;
+            }
+        }
+    }
+}
+
+// N[,rr[,quantum]]
+mima_bool mima_smp_run(mima_t *mima, const char *config)
+{
+    char *end;
+    uint32_t count = strtoul(config, &end, 0);
+    mima_bool round_robin = mima_false;
+    uint32_t quantum = 1;
+
+    if (strncmp(end, ",rr", 3) == 0)
+    {
+        round_robin = mima_true;
+        end += 3;
+
+        if (*end == ',')
+        {
+            quantum = strtoul(end + 1, &end, 0);
+        }
+    }
+
+    if (*end != 0 || count == 0 || count > MIMA_SMP_MAX_CORES || quantum == 0)
+    {
+        log_error("Expected N[,rr[,quantum]] with 1 - %d cores, got %s", MIMA_SMP_MAX_CORES, config);
+        return mima_false;
+    }
+
+    if (mima->checkpoint)
+    {
+        log_error("Checkpoints only hold a single core :(");
+        return mima_false;
+    }
+
+    if (!mima->control_unit.RUN)
+    {
+        log_warn("The Mima is not running, no core is started.");
+        return mima_true;
+    }
+
+    mima_t *cores[MIMA_SMP_MAX_CORES] = { mima };
+    mima_t *copies = calloc(count, sizeof(mima_t));
+
+    if (!copies)
+    {
+        log_error("Could not allocate memory for %u cores :(", count);
+        return mima_false;
+    }
+
+    mima->core = 0;
+    mima->cores = count;
+
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        cores[i] = &copies[i];
+        mima_smp_init_core(cores[i], mima, i, count);
+    }
+
+    uint64_t start = mima_smp_now();
+
+    if (round_robin)
+    {
+        mima_smp_run_round_robin(cores, count, quantum);
+    }
+    else
+    {
+        mima_smp_run_threads(cores, count);
+    }
+
+    uint64_t elapsed = mima_smp_now() - start;
+    uint64_t total = 0;
+
+    printf("\n");
+    printf("=======CORES=============\n");
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        printf(" CORE %-2u    = %llu instructions, %s\n", i, (unsigned long long)cores[i]->counters.instructions, mima_stop_reason_name(cores[i]->stop_reason));
+        total += cores[i]->counters.instructions;
+
+        if (i > 0)
+        {
+            mima->memory_unit.dirty_pages_count += cores[i]->memory_unit.dirty_pages_count;
+
+            // a core over its budget decides the exit status
+            if (mima->stop_reason < MIMA_STOP_INSTRUCTIONS && cores[i]->stop_reason >= MIMA_STOP_INSTRUCTIONS)
+            {
+                mima->stop_reason = cores[i]->stop_reason;
+            }
+        }
+    }
+
+    printf(" TOTAL\t    = %llu instructions in %.3f s (%.1f MIPS)\n", (unsigned long long)total, elapsed / 1e6, elapsed ? (double)total / elapsed : 0.0);
+    printf("=========================\n");
+
+    free(copies);
+    return mima_true;
+}
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mima_telemetry.h"
+#include "mima_watchdog.h"
+#include "log.h"
+
+static uint64_t mima_telemetry_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static mima_telemetry_sample mima_telemetry_read(mima_telemetry *telemetry)
+{
+    mima_telemetry_sample *published = &telemetry->published;
+    mima_telemetry_sample sample;
+
+    sample.instructions = __atomic_load_n(&published->instructions, __ATOMIC_RELAXED);
+    sample.micro_cycles = __atomic_load_n(&published->micro_cycles, __ATOMIC_RELAXED);
+    sample.cycles = __atomic_load_n(&published->cycles, __ATOMIC_RELAXED);
+    sample.io_reads = __atomic_load_n(&published->io_reads, __ATOMIC_RELAXED);
+    sample.io_writes = __atomic_load_n(&published->io_writes, __ATOMIC_RELAXED);
+    sample.output_bytes = __atomic_load_n(&published->output_bytes, __ATOMIC_RELAXED);
+    sample.pages = __atomic_load_n(&published->pages, __ATOMIC_RELAXED);
+    sample.stop_reason = __atomic_load_n(&published->stop_reason, __ATOMIC_RELAXED);
+
+    return sample;
+}
+
+static void mima_telemetry_write_json(mima_telemetry *telemetry, mima_telemetry_sample *sample, uint64_t rate)
+{
+    FILE *file = fopen(telemetry->file_name, "a");
+
+    if (!file)
+    {
+        log_warn("Failed to open %s :(", telemetry->file_name);
+        return;
+    }
+
+    fprintf(file, "{\"time\":%llu,\"instructions\":%llu,\"instructions_per_second\":%llu,\"micro_cycles\":%llu,\"cycles\":%llu,"
+                  "\"io_reads\":%llu,\"io_writes\":%llu,\"output_bytes\":%llu,\"pages\":%u,\"log_dropped\":%lu,\"stop\":\"%s\"}\n",
+            (unsigned long long)time(NULL), (unsigned long long)sample->instructions, (unsigned long long)rate,
+            (unsigned long long)sample->micro_cycles, (unsigned long long)sample->cycles, (unsigned long long)sample->io_reads,
+            (unsigned long long)sample->io_writes, (unsigned long long)sample->output_bytes, sample->pages, log_get_dropped(),
+            mima_stop_reason_name(sample->stop_reason));
+
+    fclose(file);
+}
+
+static void mima_telemetry_metric(FILE *file, const char *name, const char *type, const char *help, unsigned long long value)
+{
+    fprintf(file, "# HELP mima_%s %s\n# TYPE mima_%s %s\nmima_%s %llu\n", name, help, name, type, name, value);
+}
+
+static void mima_telemetry_write_prometheus(mima_telemetry *telemetry, mima_telemetry_sample *sample, uint64_t rate)
+{
+    char temporary[4096 + 8];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", telemetry->file_name);
+
+    FILE *file = fopen(temporary, "w");
+
+    if (!file)
+    {
+        log_warn("Failed to open %s :(", temporary);
+        return;
+    }
+
+    mima_telemetry_metric(file, "instructions_total", "counter", "Retired instructions.", sample->instructions);
+    mima_telemetry_metric(file, "instructions_per_second", "gauge", "Retired instructions per second since the last sample.", rate);
+    mima_telemetry_metric(file, "micro_cycles_total", "counter", "Micro steps the engines walked.", sample->micro_cycles);
+    mima_telemetry_metric(file, "cycles_total", "counter", "Cycles of the timing model.", sample->cycles);
+    mima_telemetry_metric(file, "io_reads_total", "counter", "Reads from the I/O space.", sample->io_reads);
+    mima_telemetry_metric(file, "io_writes_total", "counter", "Writes to the I/O space.", sample->io_writes);
+    mima_telemetry_metric(file, "output_bytes_total", "counter", "Bytes printed by the output devices.", sample->output_bytes);
+    mima_telemetry_metric(file, "pages", "gauge", "Memory pages written at least once.", sample->pages);
+    mima_telemetry_metric(file, "log_dropped_total", "counter", "Log messages that could not be written.", log_get_dropped());
+    fprintf(file, "# HELP mima_stop Why the Mima stopped last.\n# TYPE mima_stop gauge\nmima_stop{reason=\"%s\"} 1\n",
+            mima_stop_reason_name(sample->stop_reason));
+
+    // the collector must never see half a file
+    if (fclose(file) != 0 || rename(temporary, telemetry->file_name) != 0)
+    {
+        log_warn("Failed to write %s :(", telemetry->file_name);
+        remove(temporary);
+    }
+}
+
+static void mima_telemetry_sample_now(mima_telemetry *telemetry)
+{
+    mima_telemetry_sample sample = mima_telemetry_read(telemetry);
+    uint64_t now = mima_telemetry_now();
+    uint64_t elapsed = now - telemetry->last_time;
+    uint64_t rate = elapsed ? (sample.instructions - telemetry->last.instructions) * 1000 / elapsed : 0;
+
+    if (telemetry->prometheus)
+    {
+        mima_telemetry_write_prometheus(telemetry, &sample, rate);
+    }
+    else
+    {
+        mima_telemetry_write_json(telemetry, &sample, rate);
+    }
+
+    telemetry->last = sample;
+    telemetry->last_time = now;
+    telemetry->samples++;
+}
+
+static void *mima_telemetry_sampler(void *argument)
+{
+    mima_telemetry *telemetry = argument;
+
+    pthread_mutex_lock(&telemetry->mutex);
+
+    while (!telemetry->quit)
+    {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += telemetry->period / 1000;
+        until.tv_nsec += (long)(telemetry->period % 1000) * 1000000;
+
+        if (until.tv_nsec >= 1000000000)
+        {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+
+        // woken up early only to quit
+        while (!telemetry->quit && pthread_cond_timedwait(&telemetry->condition, &telemetry->mutex, &until) == 0) {}
+
+        if (!telemetry->quit)
+        {
+            pthread_mutex_unlock(&telemetry->mutex);
+            mima_telemetry_sample_now(telemetry);
+            pthread_mutex_lock(&telemetry->mutex);
+        }
+    }
+
+    pthread_mutex_unlock(&telemetry->mutex);
+    return NULL;
+}
+
+// file[,ms]
+mima_telemetry *mima_telemetry_create(const char *config, mima_t *mima)
+{
+    mima_telemetry *telemetry = calloc(1, sizeof(mima_telemetry));
+
+    if (!telemetry)
+    {
+        return NULL;
+    }
+
+    size_t length = strcspn(config, ",");
+    snprintf(telemetry->file_name, sizeof(telemetry->file_name), "%.*s", (int)length, config);
+    telemetry->period = 1000;
+
+    if (config[length] == ',')
+    {
+        char *end;
+        telemetry->period = strtoul(&config[length + 1], &end, 0);
+
+        if (*end != 0 || telemetry->period == 0)
+        {
+            log_error("Expected file[,ms], got %s", config);
+            free(telemetry);
+            return NULL;
+        }
+    }
+
+    length = strlen(telemetry->file_name);
+    telemetry->prometheus = length >= 5 && strcmp(&telemetry->file_name[length - 5], ".prom") == 0;
+
+    mima_telemetry_publish(telemetry, mima);
+    telemetry->last = telemetry->published;
+    telemetry->last_time = mima_telemetry_now();
+    pthread_mutex_init(&telemetry->mutex, NULL);
+    pthread_cond_init(&telemetry->condition, NULL);
+
+    if (pthread_create(&telemetry->thread, NULL, mima_telemetry_sampler, telemetry) != 0)
+    {
+        log_error("Could not start the telemetry thread :(");
+        pthread_mutex_destroy(&telemetry->mutex);
+        pthread_cond_destroy(&telemetry->condition);
+        free(telemetry);
+        return NULL;
+    }
+
+    return telemetry;
+}
+
+void mima_telemetry_delete(mima_telemetry *telemetry, mima_t *mima)
+{
+    if (!telemetry)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&telemetry->mutex);
+    telemetry->quit = mima_true;
+    pthread_cond_signal(&telemetry->condition);
+    pthread_mutex_unlock(&telemetry->mutex);
+    pthread_join(telemetry->thread, NULL);
+
+    // the last sample has the final counters and the stop reason
+    mima_telemetry_publish(telemetry, mima);
+    mima_telemetry_sample_now(telemetry);
+    log_info("Wrote %llu telemetry sample(s) to %s.", (unsigned long long)telemetry->samples, telemetry->file_name);
+
+    pthread_mutex_destroy(&telemetry->mutex);
+    pthread_cond_destroy(&telemetry->condition);
+    free(telemetry);
+}
+
+void mima_telemetry_publish(mima_telemetry *telemetry, mima_t *mima)
+{
+    mima_telemetry_sample *published = &telemetry->published;
+
+    __atomic_store_n(&published->instructions, mima->counters.instructions, __ATOMIC_RELAXED);
+    __atomic_store_n(&published->micro_cycles, mima->counters.micro_cycles, __ATOMIC_RELAXED);
+    __atomic_store_n(&published->cycles, mima->counters.cycles, __ATOMIC_RELAXED);
+    __atomic_store_n(&published->io_reads, mima->counters.io_reads, __ATOMIC_RELAXED);
+    __atomic_store_n(&published->io_writes, mima->counters.io_writes, __ATOMIC_RELAXED);
+    __atomic_store_n(&published->output_bytes, mima->counters.output_bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&published->pages, mima->memory_unit.dirty_pages_count, __ATOMIC_RELAXED);
+    __atomic_store_n(&published->stop_reason, (uint32_t)mima->stop_reason, __ATOMIC_RELAXED);
+
+    telemetry->due = mima->counters.instructions + MIMA_TELEMETRY_INTERVAL;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "mima_timing.h"
+#include "mima_cache.h"
+#include "log.h"
+
+static mima_instruction_type mima_op_code_of_slot(uint32_t slot)
+{
+    return slot < 0x10 ? slot : 0xF0 + (slot - 0x10);
+}
+
+void mima_timing_init(mima_timing *timing)
+{
+    for (uint32_t slot = 0; slot < mima_op_slots; ++slot)
+    {
+        timing->cycles[slot] = 12;
+    }
+
+    // HLT stops in micro cycle 6
+    timing->cycles[mima_op_slot(HLT)] = 6;
+    timing->io_read_latency = 0;
+    timing->io_write_latency = 0;
+    timing->cache_miss_latency = 0;
+}
+
+static mima_bool mima_timing_set(mima_timing *timing, const char *name, uint32_t cycles)
+{
+    if (strcasecmp(name, "IO_READ") == 0)
+    {
+        timing->io_read_latency = cycles;
+        return mima_true;
+    }
+
+    if (strcasecmp(name, "IO_WRITE") == 0)
+    {
+        timing->io_write_latency = cycles;
+        return mima_true;
+    }
+
+    if (strcasecmp(name, "CACHE_MISS") == 0)
+    {
+        timing->cache_miss_latency = cycles;
+        return mima_true;
+    }
+
+    for (uint32_t slot = 0; slot < mima_op_slots; ++slot)
+    {
+        if (strcasecmp(name, mima_get_instruction_name(mima_op_code_of_slot(slot))) == 0)
+        {
+            timing->cycles[slot] = cycles;
+            return mima_true;
+        }
+    }
+
+    return mima_false;
+}
+
+mima_bool mima_timing_load(mima_timing *timing, const char *file_name)
+{
+    FILE *file = fopen(file_name, "r");
+
+    if (!file)
+    {
+        log_error("Failed to open timing model %s :(", file_name);
+        return mima_false;
+    }
+
+    char line[256];
+    uint32_t line_number = 0;
+    mima_bool result = mima_true;
+
+    while (fgets(line, sizeof(line), file))
+    {
+        line_number++;
+
+        char name[32];
+        char cycles_string[32];
+        int fields = sscanf(line, "%31s %31s", name, cycles_string);
+
+        if (fields <= 0 || name[0] == '#' || strncmp(name, "//", 2) == 0)
+        {
+            continue;
+        }
+
+        char *endptr;
+        uint32_t cycles = fields == 2 ? strtoul(cycles_string, &endptr, 0) : 0;
+
+        if (fields != 2 || *endptr != 0 || !mima_timing_set(timing, name, cycles))
+        {
+            log_error("%s:%u: expected \"MNEMONIC cycles\", got %s", file_name, line_number, line);
+            result = mima_false;
+        }
+    }
+
+    fclose(file);
+
+    return result;
+}
+
+void mima_timing_print_stats(mima_t *mima)
+{
+    mima_counters *counters = &mima->counters;
+
+    printf("\n");
+    printf("=======TIMING MODEL======\n");
+    printf(" OP      INSTR       CYCLES   SHARE\n");
+
+    for (uint32_t slot = 0; slot < mima_op_slots; ++slot)
+    {
+        uint64_t instructions = counters->op_instructions[slot];
+
+        if (instructions == 0)
+        {
+            continue;
+        }
+
+        uint64_t cycles = instructions * mima->timing.cycles[slot];
+        printf(" %-4s %10llu %12llu  %5.1f%%\n", mima_get_instruction_name(mima_op_code_of_slot(slot)), (unsigned long long)instructions, (unsigned long long)cycles, counters->cycles ? 100.0 * cycles / counters->cycles : 0.0);
+    }
+
+    uint64_t io_cycles = counters->io_reads * mima->timing.io_read_latency + counters->io_writes * mima->timing.io_write_latency;
+    printf(" I/O  %10llu %12llu  %5.1f%%\n", (unsigned long long)(counters->io_reads + counters->io_writes), (unsigned long long)io_cycles, counters->cycles ? 100.0 * io_cycles / counters->cycles : 0.0);
+
+    if (mima->cache)
+    {
+        uint64_t misses = mima->cache->read_misses + mima->cache->write_misses;
+        uint64_t miss_cycles = misses * mima->timing.cache_miss_latency;
+        printf(" MISS %10llu %12llu  %5.1f%%\n", (unsigned long long)misses, (unsigned long long)miss_cycles, counters->cycles ? 100.0 * miss_cycles / counters->cycles : 0.0);
+    }
+
+    printf(" CYCLES\t    = %llu\n", (unsigned long long)counters->cycles);
+    printf(" CPI\t    = %.2f\n", counters->instructions ? (double)counters->cycles / counters->instructions : 0.0);
+    printf("=========================\n");
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mima_watchdog.h"
+#include "log.h"
+
+static const char *mima_stop_reason_names[] = { "none", "halt", "error", "input", "instructions", "time", "pages", "output" };
+
+const char *mima_stop_reason_name(mima_stop_reason reason)
+{
+    return reason <= MIMA_STOP_OUTPUT ? mima_stop_reason_names[reason] : "unknown";
+}
+
+static uint64_t mima_watchdog_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void mima_watchdog_schedule(mima_t *mima)
+{
+    mima_limits *limits = &mima->limits;
+
+    if (!limits->instructions && !limits->seconds && !limits->pages && !limits->output_bytes)
+    {
+        limits->due = UINT64_MAX;
+        return;
+    }
+
+    limits->due = mima->counters.instructions + MIMA_WATCHDOG_INTERVAL;
+
+    if (limits->instructions && limits->instructions < limits->due)
+    {
+        limits->due = limits->instructions;
+    }
+}
+
+// instructions=#,seconds=#,pages=#,output=# in any order, all optional
+mima_bool mima_watchdog_set(mima_t *mima, const char *config)
+{
+    mima_limits limits = {0};
+    const char *cursor = config;
+
+    while (*cursor)
+    {
+        const char *equals = strchr(cursor, '=');
+        size_t length = equals ? (size_t)(equals - cursor) : 0;
+        char *end;
+        uint64_t value = equals ? strtoull(equals + 1, &end, 0) : 0;
+
+        if (!equals || end == equals + 1 || (*end != ',' && *end != 0))
+        {
+            log_error("Expected instructions=#,seconds=#,pages=#,output=#, got %s", config);
+            return mima_false;
+        }
+
+        if (length == 12 && strncmp(cursor, "instructions", length) == 0)
+        {
+            limits.instructions = value;
+        }
+        else if (length == 7 && strncmp(cursor, "seconds", length) == 0)
+        {
+            limits.seconds = value;
+        }
+        else if (length == 5 && strncmp(cursor, "pages", length) == 0)
+        {
+            limits.pages = value;
+        }
+        else if (length == 6 && strncmp(cursor, "output", length) == 0)
+        {
+            limits.output_bytes = value;
+        }
+        else
+        {
+            log_error("Unknown limit %.*s", (int)length, cursor);
+            return mima_false;
+        }
+
+        cursor = *end == ',' ? end + 1 : end;
+    }
+
+    limits.start = mima_watchdog_now();
+    mima->limits = limits;
+    mima_watchdog_schedule(mima);
+
+    return mima_true;
+}
+
+void mima_watchdog_check(mima_t *mima)
+{
+    mima_limits *limits = &mima->limits;
+    mima_stop_reason reason = MIMA_STOP_NONE;
+
+    if (limits->instructions && mima->counters.instructions >= limits->instructions)
+    {
+        reason = MIMA_STOP_INSTRUCTIONS;
+    }
+    else if (limits->pages && mima->memory_unit.dirty_pages_count > limits->pages)
+    {
+        reason = MIMA_STOP_PAGES;
+    }
+    else if (limits->output_bytes && mima->counters.output_bytes > limits->output_bytes)
+    {
+        reason = MIMA_STOP_OUTPUT;
+    }
+    else if (limits->seconds && mima_watchdog_now() - limits->start >= limits->seconds * 1000)
+    {
+        reason = MIMA_STOP_TIME;
+    }
+
+    mima_watchdog_schedule(mima);
+
+    if (reason != MIMA_STOP_NONE)
+    {
+        mima->control_unit.RUN = mima_false;
+        mima->stop_reason = reason;
+        log_warn("Watchdog: stopped after %llu instructions, the %s limit is reached.", (unsigned long long)mima->counters.instructions, mima_stop_reason_name(reason));
+
+        // check again after the next instruction
+        limits->due = mima->counters.instructions;
+    }
+}
+
+void mima_watchdog_print(mima_t *mima)
+{
+    mima_limits *limits = &mima->limits;
+    uint64_t seconds = limits->start ? (mima_watchdog_now() - limits->start) / 1000 : 0;
+
+    printf("\n");
+    printf("=======LIMITS============\n");
+    printf(" INSTR\t    = %llu / %llu\n", (unsigned long long)mima->counters.instructions, (unsigned long long)limits->instructions);
+    printf(" SECONDS    = %llu / %llu\n", (unsigned long long)seconds, (unsigned long long)limits->seconds);
+    printf(" PAGES\t    = %u / %u\n", mima->memory_unit.dirty_pages_count, limits->pages);
+    printf(" OUTPUT\t    = %llu / %llu\n", (unsigned long long)mima->counters.output_bytes, (unsigned long long)limits->output_bytes);
+    printf(" STOP\t    = %s\n", mima_stop_reason_name(mima->stop_reason));
+    printf("=========================\n");
+}